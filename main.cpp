@@ -1,21 +1,125 @@
 #include "tokenize/tokenize.hpp"
 
+#include <charconv>
 #include <iostream>
+#include <string_view>
+#include <thread>
 
-int main(int argc, char **argv) {
+// silang --batch [--jobs=N] [files...]
+// ファイルを並列に字句解析して入力順に出力する
+// ファイルが指定されなければ標準入力から1行に1つずつパスを読む
+static int run_batch(int argc, char **argv) {
+    using namespace tokenize;
+    using namespace std;
+
+    size_t jobs = std::max(1u, std::thread::hardware_concurrency());
+    vector<string> paths;
+    for (int i = 2; i < argc; i++) {
+        const string_view arg = argv[i];
+        if (arg.starts_with("--jobs=")) {
+            const string_view value = arg.substr(7);
+            const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), jobs);
+            if (error != std::errc() || end != value.data() + value.size()) {
+                cerr << "unknown option: " << arg << endl;
+                return 1;
+            }
+            jobs = std::max<size_t>(1, jobs);
+        } else {
+            paths.emplace_back(arg);
+        }
+    }
+    if (paths.empty()) {
+        string path;
+        while (std::getline(cin, path)) {
+            if (!path.empty()) {
+                paths.push_back(path);
+            }
+        }
+    }
+
+    const batch_result result = tokenize_files(paths, jobs);
+    for (size_t i = 0; i < result.size(); i++) {
+        cout << result.path(i) << endl;
+        if (result.opened(i)) {
+            cout << result.tokens(i) << endl;
+        } else {
+            cout << "failed" << endl;
+        }
+    }
+    return 0;
+}
+
+// silang --profile
+// 標準入力を1行ずつ字句解析し、トークンの代わりに名前付きパーサの計数を読み戻したバイト数の多い順に出力する
+// TOKENIZE_PROFILE=ONでビルドしたときだけ使える
+static int run_profile() {
     using namespace tokenize;
     using namespace std;
 
+#if TOKENIZE_PROFILE
     string line;
     while (std::getline(cin, line)) {
-        reader_ptr reader = tokenize::make_string_reader(line);
-        std::string s = "";
+        view_reader source(line);
+        view_reader *reader = &source;
+        std::vector<lexeme> ls;
+        tokenize_all(reader, ls);
+    }
+    profile::report(cout);
+    return 0;
+#else
+    cerr << "built without TOKENIZE_PROFILE" << endl;
+    return 1;
+#endif
+}
 
-        std::vector<token> ts;
-        if (tokenize_all(reader, ts)) {
-            cout << ts << endl;
+// silang [--recover] [--format=text|jsonl|binary]
+// 標準入力を1行ずつ字句解析して出力する
+// --recoverなら読めない範囲をerrorトークンにして行末まで続ける
+// 出力はまとめて書き出すので、行ごとにはflushしない
+int main(int argc, char **argv) {
+    using namespace tokenize;
+    using namespace std;
+
+    if (argc > 1 && string_view(argv[1]) == "--batch") {
+        return run_batch(argc, argv);
+    }
+    if (argc > 1 && string_view(argv[1]) == "--profile") {
+        return run_profile();
+    }
+    bool recover = false;
+    format_t format = format_t::text;
+    for (int i = 1; i < argc; i++) {
+        const string_view arg = argv[i];
+        if (arg == "--recover") {
+            recover = true;
+        } else if (const auto f = arg.starts_with("--format=") ? parse_format(arg.substr(9)) : nullopt; f) {
+            format = *f;
         } else {
-            cout << "failed" << endl;
+            cerr << "unknown option: " << arg << endl;
+            return 1;
+        }
+    }
+
+    // 診断は行ごとにまとめて書き出す
+    diagnostic_sink diagnostics;
+    token_writer out(cout, format);
+    string line;
+    size_t offset = 0; // 行の先頭の入力上の位置
+    for (size_t number = 0; std::getline(cin, line); number++, offset += line.size() + 1) {
+        // lineはループ内で生存するので借用して読む
+        // 具象型のまま渡して文法全体をインライン化する
+        view_reader source(line);
+        view_reader *reader = &source;
+        source.set_diagnostics(&diagnostics);
+
+        std::vector<token> ts;
+        const bool result = recover ? (tokenize_all_recovering(reader, ts), true) : tokenize_all(reader, ts);
+        diagnostics.format(cerr);
+        diagnostics.clear();
+        if (!(result ? out.write(ts, number, offset) : out.write_failed(number))) {
+            out.flush();
+            cerr << "line " << number << ": position does not fit the output format" << endl;
+            return 1;
         }
     }
 
@@ -0,0 +1,344 @@
+#include "automata.hpp"
+#include <algorithm>
+#include <map>
+#include <optional>
+namespace tokenize::automata {
+
+int32_t nfa::split(std::vector<int32_t> eps) {
+    std::erase(eps, -1);
+    nodes.push_back(node{node::split, std::move(eps)});
+    return nodes.size() - 1;
+}
+
+int32_t nfa::consume(const match_t &on, bool eof, int32_t next) {
+    node n{node::consume};
+    n.on = on, n.eof = eof, n.next = next;
+    nodes.push_back(n);
+    return nodes.size() - 1;
+}
+
+int32_t nfa::accept(int32_t tag) {
+    node n{node::accept};
+    n.tag = tag;
+    nodes.push_back(n);
+    return nodes.size() - 1;
+}
+
+int32_t nfa::reject() {
+    node n{node::reject};
+    n.level = depth;
+    nodes.push_back(n);
+    return nodes.size() - 1;
+}
+
+int32_t nfa::barrier() {
+    node n{node::barrier};
+    n.level = depth;
+    nodes.push_back(n);
+    return nodes.size() - 1;
+}
+
+int32_t build(nfa &n, const parsers::atom &a, const exits &to) {
+    // 読めなければ何も読まずに失敗する
+    return n.split({n.consume(a.get_match(), false, to.ok_consumed), to.fail_empty});
+}
+
+int32_t build(nfa &n, const parsers::multi &m, const exits &to) {
+    // 一致した分は読み進めたまま失敗する
+    const std::string_view keyword = m.get_keyword();
+    int32_t next = keyword.empty() ? to.ok_empty : to.ok_consumed;
+    for (size_t i = keyword.size(); i-- > 0;) {
+        next = n.split({n.consume(parsers::one(keyword[i]).get_match(), false, next),
+                        i == 0 ? to.fail_empty : to.fail_consumed});
+    }
+    return next;
+}
+
+int32_t build(nfa &n, const parsers::eof_t &, const exits &to) {
+    return n.split({n.consume(match_t(), true, to.ok_empty), to.fail_empty});
+}
+
+namespace {
+
+// キーワードのトライ
+// 長く一致するほど優先し、どれにも一致しなければ読み始めた位置へ戻る
+int32_t build_trie(nfa &n, std::span<const std::string_view> keywords, const std::vector<int32_t> &accepts,
+                   int32_t fail, std::string_view prefix = {}) {
+    std::vector<int32_t> eps;
+    std::map<unsigned char, bool> children;
+    int32_t accept = -1;
+    for (size_t i = 0; i < keywords.size(); i++) {
+        const std::string_view keyword = keywords[i];
+        if (!keyword.starts_with(prefix)) {
+            continue;
+        }
+        if (keyword.size() > prefix.size()) {
+            children[keyword[prefix.size()]] = true;
+        } else if (accept < 0) {
+            accept = accepts[i]; // 同じキーワードは先のものを使う
+        }
+    }
+    for (const auto &[c, _] : children) {
+        std::string next(prefix);
+        next.push_back(c);
+        eps.push_back(n.consume(parsers::one(c).get_match(), false, build_trie(n, keywords, accepts, -1, next)));
+    }
+    eps.push_back(accept);
+    eps.push_back(fail);
+    return n.split(eps);
+}
+
+} // namespace
+
+int32_t build(nfa &n, const parsers::multi_list &m, const exits &to) {
+    const auto keywords = m.get_keywords();
+    std::vector<int32_t> accepts(keywords.size());
+    for (size_t i = 0; i < keywords.size(); i++) {
+        accepts[i] = keywords[i].empty() ? to.ok_empty : to.ok_consumed;
+    }
+    return build_trie(n, keywords, accepts, to.fail_empty);
+}
+
+int32_t build(nfa &n, const tokens::token_table &t, const exits &to) {
+    const auto keywords = t.get_list().get_keywords();
+    std::vector<int32_t> accepts(keywords.size());
+    for (size_t i = 0; i < keywords.size(); i++) {
+        accepts[i] = n.accept(int32_t(t.get_ids()[i]));
+    }
+    return build_trie(n, keywords, accepts, to.fail_empty);
+}
+
+namespace {
+
+// 優先度順の実行中のconsumeノード(とbarrier)と、それより優先度の高い受理
+struct subset {
+    std::vector<int32_t> threads;
+    int32_t tag = dfa::none;
+
+    bool operator<(const subset &s) const { return std::tie(threads, tag) < std::tie(s.threads, s.tag); }
+};
+
+// 空遷移で辿れるノードを優先度順に集める
+// 受理に辿り着いたら、それより優先度の低いものは捨てる(leftmost-first)
+// rejectに辿り着いたら、同じ深さ以下のbarrierまで捨てる
+// barrierを挟むと捨てる範囲が変わるので、同じノードでもbarrierの前後では別の候補として扱う
+subset closure(const nfa &n, const std::vector<int32_t> &seeds, std::vector<uint32_t> &visited, uint32_t &mark) {
+    subset s;
+    std::vector<int32_t> stack(seeds.rbegin(), seeds.rend());
+    std::optional<uint32_t> discard;
+    while (!stack.empty()) {
+        const int32_t id = stack.back();
+        stack.pop_back();
+        const nfa::node &node = n.nodes[id];
+        if (discard) {
+            if (node.kind != nfa::node::barrier || node.level > *discard) {
+                continue;
+            }
+            discard.reset();
+        }
+        if (node.kind == nfa::node::barrier) {
+            s.threads.push_back(id);
+            mark++;
+            continue;
+        }
+        if (visited[id] == mark) {
+            continue;
+        }
+        visited[id] = mark;
+        switch (node.kind) {
+        case nfa::node::split:
+            stack.insert(stack.end(), node.eps.rbegin(), node.eps.rend());
+            break;
+        case nfa::node::consume:
+            s.threads.push_back(id);
+            break;
+        case nfa::node::barrier:
+            break;
+        case nfa::node::accept:
+            s.tag = node.tag;
+            stack.clear();
+            break;
+        case nfa::node::reject:
+            if (node.level == 0) {
+                s.tag = dfa::rejected;
+                stack.clear();
+            }
+            discard = node.level;
+            break;
+        }
+    }
+
+    // 前に候補のないbarrierや、より浅いbarrierの直前のbarrierは何も区切らない
+    const auto useless = [&](size_t i) {
+        const nfa::node &node = n.nodes[s.threads[i]];
+        if (node.kind != nfa::node::barrier) {
+            return false;
+        }
+        if (i == 0 || i + 1 == s.threads.size()) {
+            return true;
+        }
+        const nfa::node &next = n.nodes[s.threads[i + 1]];
+        return next.kind == nfa::node::barrier && next.level <= node.level;
+    };
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t i = 0; i < s.threads.size(); i++) {
+            if (useless(i)) {
+                s.threads.erase(s.threads.begin() + i);
+                changed = true;
+                break;
+            }
+        }
+    }
+    return s;
+}
+
+} // namespace
+
+dfa::dfa(const nfa &n) {
+    // 区別する必要のある文字だけを文字クラスにまとめる
+    std::array<uint32_t, 257> symbols{};
+    for (const nfa::node &node : n.nodes) {
+        if (node.kind != nfa::node::consume) {
+            continue;
+        }
+        std::map<std::pair<uint32_t, bool>, uint32_t> refined;
+        for (size_t c = 0; c < 257; c++) {
+            const bool in = c < 256 ? node.on.test(c) : node.eof;
+            symbols[c] = refined.insert({{symbols[c], in}, uint32_t(refined.size())}).first->second;
+        }
+    }
+    const uint32_t symbol_count = *std::max_element(symbols.begin(), symbols.end()) + 1;
+    std::vector<uint16_t> representative(symbol_count);
+    for (size_t c = 257; c-- > 0;) {
+        representative[symbols[c]] = c;
+    }
+
+    // 部分集合構成(0は行き止まり)
+    std::vector<subset> states{subset{}};
+    std::map<subset, uint32_t> ids{{subset{}, 0}};
+    std::vector<std::vector<uint32_t>> transitions{std::vector<uint32_t>(symbol_count, 0)};
+    std::vector<uint32_t> visited(n.nodes.size(), 0);
+    uint32_t mark = 0;
+    auto intern = [&](subset &&s) {
+        const auto [iter, inserted] = ids.insert({s, uint32_t(states.size())});
+        if (inserted) {
+            states.push_back(std::move(s));
+            transitions.emplace_back(symbol_count, 0);
+        }
+        return iter->second;
+    };
+    const uint32_t initial = intern(closure(n, {n.start}, visited, ++mark));
+    for (uint32_t i = 1; i < states.size(); i++) {
+        for (uint32_t k = 0; k < symbol_count; k++) {
+            const size_t c = representative[k];
+            std::vector<int32_t> seeds;
+            for (const int32_t id : states[i].threads) {
+                const nfa::node &node = n.nodes[id];
+                if (node.kind == nfa::node::barrier) {
+                    seeds.push_back(id);
+                } else if ((c < 256 ? node.on.test(c) : node.eof) && node.next >= 0) {
+                    seeds.push_back(node.next);
+                }
+            }
+            if (seeds.empty()) {
+                continue;
+            }
+            const uint32_t next = intern(closure(n, seeds, visited, ++mark));
+            transitions[i][k] = next;
+        }
+    }
+
+    // 最小化(受理するトークンの種類で分け、遷移先の組で分け直す)
+    std::vector<uint32_t> partition(states.size());
+    size_t partition_count = 0;
+    {
+        std::map<int32_t, uint32_t> initial_partition;
+        for (size_t i = 0; i < states.size(); i++) {
+            // 行き止まりは受理しない状態と同じ組から始める
+            const auto [iter, inserted] = initial_partition.insert({states[i].tag, initial_partition.size()});
+            partition[i] = iter->second;
+        }
+        partition_count = initial_partition.size();
+    }
+    while (true) {
+        std::map<std::vector<uint32_t>, uint32_t> signatures;
+        std::vector<uint32_t> refined(states.size());
+        for (size_t i = 0; i < states.size(); i++) {
+            std::vector<uint32_t> signature{partition[i]};
+            for (const uint32_t next : transitions[i]) {
+                signature.push_back(partition[next]);
+            }
+            const auto [iter, inserted] = signatures.insert({signature, signatures.size()});
+            refined[i] = iter->second;
+        }
+        partition.swap(refined);
+        if (signatures.size() == partition_count) {
+            break;
+        }
+        partition_count = signatures.size();
+    }
+
+    // 行き止まりの組を0番にして番号を振り直す
+    std::vector<uint32_t> renumber(partition_count, UINT32_MAX);
+    uint32_t count = 0;
+    renumber[partition[0]] = count++;
+    for (size_t i = 0; i < states.size(); i++) {
+        if (renumber[partition[i]] == UINT32_MAX) {
+            renumber[partition[i]] = count++;
+        }
+    }
+
+    // 文字クラスを2の冪に揃えて、状態番号を行の先頭に変換したまま引けるようにする
+    while ((size_t(1) << shift) < symbol_count) {
+        shift++;
+    }
+    for (size_t c = 0; c < 257; c++) {
+        classes[c] = symbols[c];
+    }
+    table.assign(size_t(count) << shift, 0);
+    tags.assign(count, none);
+    for (size_t i = 0; i < states.size(); i++) {
+        const uint32_t state = renumber[partition[i]];
+        tags[state] = states[i].tag;
+        for (uint32_t k = 0; k < symbol_count; k++) {
+            table[(size_t(state) << shift) + k] = renumber[partition[transitions[i][k]]] << shift;
+        }
+    }
+    start = renumber[partition[initial]] << shift;
+}
+
+lexer::lexer() : gap(compile(tokens::gap_grammar())), token(compile(tokens::token_grammar(), dfa::none)) {}
+
+const lexer &lexer::get() {
+    static const lexer l;
+    return l;
+}
+
+bool lexer::operator()(view_reader &source, lexeme &l) const {
+    const std::string_view rest = source.window();
+    const size_t skipped = gap.run(rest).length;
+    const dfa::match m = token.run(rest.substr(skipped));
+    source.set_offset(source.get_offset() + skipped);
+    if (m.tag < 0) {
+        return false;
+    }
+    l.id = tokens::token_id(m.tag);
+    l.offset = source.get_offset(), l.length = m.length;
+    source.set_offset(l.offset + l.length);
+    return true;
+}
+
+bool tokenize_all(view_reader &source, std::vector<lexeme> &ls) {
+    const lexer &l = lexer::get();
+    do {
+        lexeme t;
+        if (!l(source, t)) {
+            break;
+        }
+        ls.push_back(t);
+    } while (1);
+    return true;
+}
+
+} // namespace tokenize::automata
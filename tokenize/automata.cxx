@@ -0,0 +1,112 @@
+#pragma once
+namespace tokenize::automata {
+
+template <class> inline constexpr bool unsupported = false;
+
+template <class P> int32_t build(nfa &, const P &, const exits &) {
+    static_assert(unsupported<P>, "this parser cannot be converted to an automaton");
+    return -1;
+}
+
+template <class R, class L> int32_t build(nfa &n, const parsers::chain<R, L> &c, const exits &to) {
+    // 左が何も読まずに成功した場合と、読んで成功した場合で右の出口が変わる
+    const int32_t left_consumed = build(n, c.get_left(), to.consumed());
+    const int32_t left_empty = parsers::first_of(c.get_right()).nullable ? build(n, c.get_left(), to) : -1;
+    return build(n, c.get_right(), exits{left_empty, left_consumed, to.fail_empty, to.fail_consumed});
+}
+
+template <class T> int32_t build(nfa &n, const parsers::repeat_range<T> &r, const exits &to) {
+    const T &p = r.get_parser();
+    // 最後の段から順に作る(empty: まだ何も読んでいない, consumed: 読んだ)
+    int32_t next_empty = to.ok_empty, next_consumed = to.ok_consumed;
+    if (r.get_max() == UINT_MAX) {
+        // min回より後は失敗したところで止める(読み進めた分は戻さない)
+        const int32_t loop_empty = n.split(), loop_consumed = n.split();
+        const int32_t consumed = build(n, p, exits{loop_consumed, loop_consumed, to.ok_consumed, to.ok_consumed});
+        const int32_t empty = build(n, p, exits{loop_empty, loop_consumed, to.ok_empty, to.ok_consumed});
+        n.nodes[loop_empty].eps = {empty};
+        n.nodes[loop_consumed].eps = {consumed};
+        next_empty = loop_empty, next_consumed = loop_consumed;
+    } else {
+        assert(r.get_max() - r.get_min() <= 64); // 展開する
+        for (unsigned int i = r.get_min(); i < r.get_max(); i++) {
+            const int32_t consumed = build(n, p, exits{next_consumed, next_consumed, to.ok_consumed, to.ok_consumed});
+            const int32_t empty = build(n, p, exits{next_empty, next_consumed, to.ok_empty, to.ok_consumed});
+            next_empty = empty, next_consumed = consumed;
+        }
+    }
+    assert(r.get_min() <= 64);
+    for (unsigned int i = 0; i < r.get_min(); i++) {
+        const int32_t consumed =
+            build(n, p, exits{next_consumed, next_consumed, to.fail_consumed, to.fail_consumed});
+        const int32_t empty = build(n, p, exits{next_empty, next_consumed, to.fail_empty, to.fail_consumed});
+        next_empty = empty, next_consumed = consumed;
+    }
+    return next_empty;
+}
+
+template <class P> int32_t build(nfa &n, const parsers::attempt<P> &a, const exits &to) {
+    // 失敗したら中の候補を捨て、読み始めた位置へ戻る
+    n.depth++;
+    const int32_t reject = n.reject();
+    const int32_t inner = build(n, a.get_parser(), exits{to.ok_empty, to.ok_consumed, reject, reject});
+    const int32_t barrier = n.barrier();
+    n.depth--;
+    return n.split({inner, barrier, to.fail_empty});
+}
+
+template <class R, class L> int32_t build(nfa &n, const parsers::sum<R, L> &s, const exits &to) {
+    // 右が読み進めてから失敗したら左は試さない
+    const int32_t left = build(n, s.get_left(), to);
+    return build(n, s.get_right(), exits{to.ok_empty, to.ok_consumed, left, to.fail_consumed});
+}
+
+template <class... Ps> int32_t build(nfa &n, const parsers::static_sigma<Ps...> &s, const exits &to) {
+    // 後ろの選択肢から作り、前の選択肢が読まずに失敗したら次を試す
+    int32_t next = to.fail_empty;
+    [&]<size_t... I>(std::index_sequence<I...>) {
+        constexpr size_t count = sizeof...(Ps);
+        ((next = build(n, std::get<count - 1 - I>(s.get_parsers()),
+                       exits{to.ok_empty, to.ok_consumed, next, to.fail_consumed})),
+         ...);
+    }(std::index_sequence_for<Ps...>());
+    return next;
+}
+
+template <class B, class I, class E> int32_t build(nfa &n, const parsers::bracket<B, I, E> &b, const exits &to) {
+    // 毎回endを先に試し、失敗したらinnerを読む
+    const int32_t loop_empty = n.split(), loop_consumed = n.split();
+    const int32_t inner_consumed =
+        build(n, b.get_inner(), exits{loop_consumed, loop_consumed, to.fail_consumed, to.fail_consumed});
+    const int32_t inner_empty =
+        build(n, b.get_inner(), exits{loop_empty, loop_consumed, to.fail_empty, to.fail_consumed});
+    const int32_t end_consumed =
+        build(n, b.get_end(), exits{to.ok_consumed, to.ok_consumed, inner_consumed, inner_consumed});
+    const int32_t end_empty = build(n, b.get_end(), exits{to.ok_empty, to.ok_consumed, inner_empty, inner_consumed});
+    n.nodes[loop_empty].eps = {end_empty};
+    n.nodes[loop_consumed].eps = {end_consumed};
+    return build(n, b.get_begin(), exits{loop_empty, loop_consumed, to.fail_empty, to.fail_consumed});
+}
+
+template <class P> int32_t build(nfa &n, const parsers::memo<P> &m, const exits &to) {
+    return build(n, m.get_parser(), to);
+}
+
+template <profile::name_t Name, class P> int32_t build(nfa &n, const parsers::probe<Name, P> &p, const exits &to) {
+    return build(n, p.get_parser(), to);
+}
+
+template <class P> int32_t build(nfa &n, const tokens::tokener<P> &t, const exits &to) {
+    const int32_t accept = n.accept(int32_t(t.get_id()));
+    return build(n, t.get_parser(), exits{accept, accept, to.fail_empty, to.fail_consumed});
+}
+
+template <class P> dfa compile(const P &p, int32_t tag) {
+    nfa n;
+    const int32_t accept = tag >= 0 ? n.accept(tag) : -1;
+    const int32_t reject = n.reject();
+    n.start = build(n, p, exits{accept, accept, reject, reject});
+    return dfa(n);
+}
+
+} // namespace tokenize::automata
@@ -0,0 +1,137 @@
+#pragma once
+#include "parsers.hpp"
+#include "readers.hpp"
+#include "tokens.hpp"
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+#include <string_view>
+#include <vector>
+namespace tokenize::automata {
+using parsers::match_t;
+using readers::view_reader;
+using tokens::lexeme;
+
+// パーサを変換したNFA
+// 空遷移は優先度順に並べ、先に書いた選択肢や繰り返しの継続を優先する
+// PEGの失敗は後ろの選択肢を打ち切るので、rejectに着いたら同じattempt(barrierまで)の優先度の低い候補を捨てる
+struct nfa {
+    struct node {
+        enum kind_t : uint8_t { split, consume, accept, reject, barrier } kind = split;
+        std::vector<int32_t> eps = {}; // split: 優先度順の空遷移
+        match_t on = {};               // consume: 読める文字
+        bool eof = false;              // consume: 終端でも遷移する(終端は読み進めない)
+        int32_t next = -1;             // consume: 読んだ後
+        int32_t tag = -1;              // accept: トークンの種類
+        uint32_t level = 0;            // reject, barrier: 囲むattemptの深さ(0は全体)
+    };
+    std::vector<node> nodes;
+    int32_t start = -1;
+    uint32_t depth = 0; // 変換中のattemptの深さ
+
+    int32_t split(std::vector<int32_t> eps = {});
+    int32_t consume(const match_t &on, bool eof, int32_t next);
+    int32_t accept(int32_t tag);
+    int32_t reject();
+    int32_t barrier();
+};
+
+// 変換したパーサの出口(-1なら行き止まり)
+// PEGの失敗は読み進めた分を戻さないので、成功・失敗それぞれを読んだかどうかで分ける
+struct exits {
+    int32_t ok_empty = -1, ok_consumed = -1;
+    int32_t fail_empty = -1, fail_consumed = -1;
+
+    // すでに読み進めた後から続ける場合
+    exits consumed() const { return exits{ok_consumed, ok_consumed, fail_consumed, fail_consumed}; }
+};
+
+// pを出口がtoに繋がるNFAに変換し、入口を返す
+// 型消去したパーサ(parser_t, sigma)は中身が分からないので変換できない
+template <class P> int32_t build(nfa &, const P &, const exits &);
+int32_t build(nfa &, const parsers::atom &, const exits &);
+int32_t build(nfa &, const parsers::multi &, const exits &);
+int32_t build(nfa &, const parsers::multi_list &, const exits &);
+int32_t build(nfa &, const parsers::eof_t &, const exits &);
+int32_t build(nfa &, const tokens::token_table &, const exits &);
+template <class R, class L> int32_t build(nfa &, const parsers::chain<R, L> &, const exits &);
+template <class T> int32_t build(nfa &, const parsers::repeat_range<T> &, const exits &);
+template <class P> int32_t build(nfa &, const parsers::attempt<P> &, const exits &);
+template <class R, class L> int32_t build(nfa &, const parsers::sum<R, L> &, const exits &);
+template <class... Ps> int32_t build(nfa &, const parsers::static_sigma<Ps...> &, const exits &);
+template <class B, class I, class E> int32_t build(nfa &, const parsers::bracket<B, I, E> &, const exits &);
+template <class P> int32_t build(nfa &, const parsers::memo<P> &, const exits &);
+template <profile::name_t Name, class P> int32_t build(nfa &, const parsers::probe<Name, P> &, const exits &);
+template <class P> int32_t build(nfa &, const tokens::tokener<P> &, const exits &);
+
+// 密な遷移表を持つDFA
+// 先に書いた選択肢を優先する(leftmost-first)部分集合構成で決定化し、最小化する
+// 一致した後も優先度の高い候補が残る間は読み進め、最後に一致した位置を返すので、後戻りはしない
+class dfa {
+    std::array<uint16_t, 257> classes; // 文字(256は終端) -> 文字クラス
+    uint32_t shift = 0;                // 1状態の行は1 << shift個の文字クラス
+    std::vector<uint32_t> table;       // (状態 << shift) + 文字クラス -> 次の状態 << shift (0は行き止まり)
+    std::vector<int32_t> tags;         // 状態 -> 受理するトークンの種類(-1は受理しない, -2は失敗が確定)
+    uint32_t start = 0;                // 開始状態 << shift
+
+public:
+    static constexpr int32_t none = -1, rejected = -2;
+
+    struct match {
+        size_t length = 0;
+        int32_t tag = none; // 一致しなければ負
+    };
+
+    dfa(const nfa &);
+    size_t size() const { return tags.size(); }
+    size_t class_count() const { return size_t(1) << shift; }
+
+    // sの先頭に一致する最長(優先度の高い候補の中で)の範囲
+    match run(std::string_view s) const {
+        uint32_t state = start;
+        match m{0, tags[start >> shift]};
+        for (size_t i = 0; i < s.size(); i++) {
+            state = table[state + classes[(unsigned char)s[i]]];
+            if (state == 0) {
+                return m;
+            }
+            if (const int32_t tag = tags[state >> shift]; tag != none) {
+                m = tag >= 0 ? match{i + 1, tag} : match{};
+            }
+        }
+        // 終端でだけ成り立つ遷移(eof)
+        state = table[state + classes[256]];
+        if (const int32_t tag = tags[state >> shift]; tag != none) {
+            m = tag >= 0 ? match{s.size(), tag} : match{};
+        }
+        return m;
+    }
+};
+
+// 出口でtagを受理するDFAを作る(tagが負なら出口では受理せず、tokenerなどの受理だけを使う)
+template <class P> dfa compile(const P &p, int32_t tag = 0);
+
+// 字句の文法(gap_grammar, token_grammar)をDFAに変換した字句解析器
+// 組み合わせたパーサの実装は差分テストの基準として残す
+// (組み合わせたパーサが出す"overrun"の警告は出さない)
+class lexer {
+    dfa gap, token;
+
+public:
+    lexer();
+    // 一度だけ作って共有する
+    static const lexer &get();
+
+    size_t gap_size() const { return gap.size(); }
+    size_t token_size() const { return token.size(); }
+
+    // tokens::tokenizeと同じく、空白とコメントを読み飛ばして1トークン読む
+    bool operator()(view_reader &source, lexeme &l) const;
+};
+
+// tokens::tokenize_allと同じ結果をDFAで求める
+bool tokenize_all(view_reader &source, std::vector<lexeme> &ls);
+
+} // namespace tokenize::automata
+
+#include "automata.cxx"
@@ -0,0 +1,108 @@
+#include "acutest.h"
+#include "automata.hpp"
+#include "tokenize.hpp"
+#include <random>
+
+using namespace tokenize::parsers;
+using namespace tokenize::automata;
+using tokenize::readers::view_reader;
+namespace tokens = tokenize::tokens;
+
+// 組み合わせたパーサと同じ範囲に一致するか
+template <class P> static bool same(const P &p, const dfa &d, std::string_view input) {
+    view_reader source(input);
+    view_reader *reader = &source;
+    span s;
+    const bool result = p(reader, s);
+    const dfa::match m = d.run(input);
+    return result ? m.tag >= 0 && m.length == s.length : m.tag < 0;
+}
+
+template <class P> static void check(const P &p, std::initializer_list<std::string_view> inputs) {
+    const dfa d = compile(p);
+    for (const std::string_view input : inputs) {
+        TEST_CHECK_(same(p, d, input), "%.*s", int(input.size()), input.data());
+    }
+}
+
+// 小さな文法
+void compile_atom_test() {
+    check(one('a'), {"a", "ab", "b", ""});
+    check(multi("abc"), {"abc", "abcd", "ab", "abd", ""});
+    check(many1(digit()), {"123a", "a", "", "1"});
+    check(option(sign) * many1(digit()), {"+1", "-12x", "1", "+", "x"});
+}
+
+void compile_quirk_test() {
+    // PEGの失敗は読み進めた分を戻さない
+    check(option(one('a') * one('b')), {"ab", "ac", "a", "c"});
+    check(many0(one('a') * one('b')), {"ababa", "abac", "ab"});
+    check(one('a') * one('b') + one('a'), {"ab", "ac"});
+    check(attempt(one('a') * one('b')) + one('a'), {"ab", "ac"});
+    check(exponent, {"e5", "e+5", "e+", "e", "E-1_0x"});
+    check(real, {"1.5", "1.5e", "1.5e+x", "1.5E-3", "1.", "1.x", "0x1F.Ae3", "0b10.01", "0b12"});
+}
+
+void compile_grammar_test() {
+    check(integer, {"0", "0x", "0x1F_FF;", "0b102", "1__2", "1_", "12_x", "+0o17", "-0d99"});
+    check(text, {"\"a\"", "\"a\\\"b\"", "\"\"\"a\"b\"\"\"", "\"\"\"abc", "\"a\\", "\"\"\"\"\"\"\""});
+    check(comment, {"// a\nb", "// a", "/* a */b", "/* a", "/x", "/**/", "/*/ */"});
+    check(character, {"'a'", "'\\''", "'ab'", "'"});
+    check(variable, {"a_1 ", "_", "1a"});
+    check(boolean, {"true", "truex", "fals", "false"});
+    check(tokens::gap_grammar(), {"  a", "/* a */ // b\n c", "/ b", "/* a", "// a", ""});
+}
+
+// 字句解析全体を組み合わせたパーサと比べる
+static std::vector<tokens::lexeme> reference(std::string_view src) {
+    view_reader source(src);
+    view_reader *reader = &source;
+    std::vector<tokens::lexeme> ls;
+    tokens::tokenize_all(reader, ls);
+    return ls;
+}
+
+static bool same_lexemes(std::string_view src) {
+    const auto expect = reference(src);
+    view_reader source(src);
+    std::vector<tokens::lexeme> ls;
+    tokenize_all(source, ls);
+    if (ls.size() != expect.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < ls.size(); i++) {
+        if (ls[i].id != expect[i].id || ls[i].offset != expect[i].offset || ls[i].length != expect[i].length) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void lexer_test() {
+    const std::string src = "func main(){\n  int x=10+0x1f; // c\n  str s = \"a\\\"b\"; /* d */ 1.5e3 'q' true\n}";
+    TEST_ASSERT(same_lexemes(src));
+    TEST_CHECK(same_lexemes(""));
+    TEST_CHECK(same_lexemes("integer trueish a / b"));
+    TEST_CHECK(same_lexemes("a $ b"));
+}
+
+void lexer_random_test() {
+    const char *const fragments[] = {"int", "uint", " ",  "\n", "\r", "x",  "1", "0",  ".",  "5", "e",  "E",   "+",
+                                     "-",   "\"",   "'",  "/*", "*/", "//", "/", "*",  "=",  ";", "0x", "0b",  "F",
+                                     "_",   "(",    ")",  "{",  "}",  "\\", "$", "true", ">", "<", "!", "\"\"\"", "&"};
+    std::mt19937 rng(2);
+    for (size_t round = 0; round < 3000; round++) {
+        std::string src;
+        for (size_t i = rng() % 40; i > 0; i--) {
+            src += fragments[rng() % std::size(fragments)];
+        }
+        TEST_ASSERT_(same_lexemes(src), "%s", src.c_str());
+    }
+}
+
+TEST_LIST = {{"compile_atom_test", compile_atom_test},
+             {"compile_quirk_test", compile_quirk_test},
+             {"compile_grammar_test", compile_grammar_test},
+             {"lexer_test", lexer_test},
+             {"lexer_random_test", lexer_random_test},
+             {nullptr, nullptr}};
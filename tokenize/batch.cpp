@@ -0,0 +1,109 @@
+#include "batch.hpp"
+#include <algorithm>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+namespace tokenize::batch {
+
+std::vector<token> batch_result::tokens(size_t i) const {
+    std::vector<token> ts;
+    if (!opened(i)) {
+        return ts;
+    }
+    const view_reader &source = *entries[i].source;
+    ts.reserve(entries[i].count);
+    for (const lexeme &l : lexemes(i)) {
+        ts.push_back(l.to_token(source));
+    }
+    return ts;
+}
+
+namespace {
+
+// ワーカーごとの仕事の列
+// 持ち主は先頭(大きいもの)から取り、他のワーカーは末尾(小さいもの)から盗む
+class work_queue {
+    std::mutex mutex;
+    std::deque<size_t> items;
+
+public:
+    void push_back(size_t item) { items.push_back(item); }
+    bool pop_front(size_t &item) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (items.empty()) {
+            return false;
+        }
+        item = items.front();
+        items.pop_front();
+        return true;
+    }
+    bool steal(size_t &item) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (items.empty()) {
+            return false;
+        }
+        item = items.back();
+        items.pop_back();
+        return true;
+    }
+};
+
+} // namespace
+
+batch_result tokenize_files(const std::vector<std::string> &paths, size_t n_threads) {
+    n_threads = std::max<size_t>(1, std::min(n_threads, paths.size()));
+
+    batch_result result;
+    result.entries.resize(paths.size());
+    result.arenas.resize(n_threads);
+
+    // 大きい順に並べて順番に配る
+    std::vector<std::pair<uintmax_t, size_t>> order(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        std::error_code ec;
+        const uintmax_t size = std::filesystem::file_size(paths[i], ec);
+        order[i] = {ec ? 0 : size, i};
+    }
+    std::stable_sort(order.begin(), order.end(), [](const auto &x, const auto &y) { return x.first > y.first; });
+    std::vector<work_queue> queues(n_threads);
+    for (size_t i = 0; i < order.size(); i++) {
+        queues[i % n_threads].push_back(order[i].second);
+    }
+
+    auto work = [&](size_t w) {
+        std::vector<lexeme> &arena = result.arenas[w];
+        size_t i;
+        while (true) {
+            bool found = queues[w].pop_front(i);
+            for (size_t k = 1; !found && k < n_threads; k++) {
+                found = queues[(w + k) % n_threads].steal(i);
+            }
+            if (!found) {
+                break;
+            }
+
+            auto &e = result.entries[i];
+            e.path = paths[i];
+            e.source = std::dynamic_pointer_cast<view_reader>(readers::make_file_reader(paths[i]));
+            e.worker = w, e.first = arena.size();
+            if (e.source) {
+                view_reader *reader = e.source.get();
+                tokens::tokenize_all(reader, arena);
+            }
+            e.count = arena.size() - e.first;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t w = 1; w < n_threads; w++) {
+        workers.emplace_back(work, w);
+    }
+    work(0);
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    return result;
+}
+
+} // namespace tokenize::batch
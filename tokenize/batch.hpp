@@ -0,0 +1,43 @@
+#pragma once
+#include "readers.hpp"
+#include "tokens.hpp"
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+namespace tokenize::batch {
+using readers::view_reader;
+using tokens::lexeme, tokens::token;
+
+// 複数のファイルをまとめて字句解析した結果
+// 字句はワーカーごとの領域にまとめて確保し、各ファイルはその範囲を参照する
+class batch_result {
+    struct entry {
+        std::string path;
+        std::shared_ptr<view_reader> source; // 開けなかった場合はnullptr
+        size_t worker = 0, first = 0, count = 0;
+    };
+    std::vector<entry> entries;                // 入力順
+    std::vector<std::vector<lexeme>> arenas;   // ワーカーごとの字句の領域
+
+    friend batch_result tokenize_files(const std::vector<std::string> &, size_t);
+
+public:
+    size_t size() const { return entries.size(); }
+    const std::string &path(size_t i) const { return entries[i].path; }
+    bool opened(size_t i) const { return entries[i].source != nullptr; }
+    std::string_view source(size_t i) const { return opened(i) ? entries[i].source->view() : std::string_view(); }
+    std::span<const lexeme> lexemes(size_t i) const {
+        const entry &e = entries[i];
+        return std::span<const lexeme>(arenas[e.worker].data() + e.first, e.count);
+    }
+    // 行と列を求めてtokenに変換する
+    std::vector<token> tokens(size_t i) const;
+};
+
+// pathsを大きい順にn_threads個のワーカーへ配り、手の空いたワーカーは他から盗んで解析する
+// 結果はpathsと同じ順に並ぶ
+batch_result tokenize_files(const std::vector<std::string> &paths, size_t n_threads);
+
+} // namespace tokenize::batch
@@ -0,0 +1,62 @@
+#include "acutest.h"
+#include "batch.hpp"
+#include "tokenize.hpp"
+#include <unistd.h>
+
+using namespace tokenize;
+using tokenize::batch::tokenize_files;
+
+static std::string make_file(const std::string &body) {
+    char path[] = "/tmp/silang_batch_test_XXXXXX";
+    const int fd = mkstemp(path);
+    TEST_ASSERT(fd >= 0);
+    TEST_ASSERT(write(fd, body.data(), body.size()) == ssize_t(body.size()));
+    close(fd);
+    return path;
+}
+
+void batch_test() {
+    std::vector<std::string> bodies = {"int x = 1;", "", "/* a\nb */ y += 2.5;\nz", "a $ b"};
+    for (size_t i = 0; i < 20; i++) {
+        std::string body;
+        for (size_t k = 0; k < i * 7; k++) {
+            body += "f(x, 0x1F) == \"s\\n\";\n";
+        }
+        bodies.push_back(body);
+    }
+    std::vector<std::string> paths;
+    for (const auto &body : bodies) {
+        paths.push_back(make_file(body));
+    }
+    paths.push_back("/tmp/silang_batch_test_missing");
+
+    for (size_t n = 1; n <= 4; n++) {
+        const auto result = tokenize_files(paths, n);
+        TEST_ASSERT(result.size() == paths.size());
+        for (size_t i = 0; i < bodies.size(); i++) {
+            TEST_CHECK(result.path(i) == paths[i] && result.opened(i));
+            TEST_CHECK(result.source(i) == bodies[i]);
+
+            auto reader = make_view_reader(bodies[i]);
+            std::vector<token> expect;
+            tokenize_all(reader, expect);
+            const auto ts = result.tokens(i);
+            TEST_ASSERT(ts.size() == expect.size() && result.lexemes(i).size() == expect.size());
+            for (size_t k = 0; k < ts.size(); k++) {
+                TEST_CHECK(ts[k].id == expect[k].id && ts[k].pos == expect[k].pos && ts[k].text == expect[k].text);
+            }
+        }
+        TEST_CHECK(!result.opened(bodies.size()) && result.lexemes(bodies.size()).empty());
+    }
+
+    for (size_t i = 0; i < bodies.size(); i++) {
+        unlink(paths[i].c_str());
+    }
+}
+
+void batch_empty_test() {
+    const auto result = tokenize_files({}, 4);
+    TEST_ASSERT(result.size() == 0);
+}
+
+TEST_LIST = {{"batch_test", batch_test}, {"batch_empty_test", batch_empty_test}, {nullptr, nullptr}};
@@ -0,0 +1,56 @@
+#include "buffers.hpp"
+#include <cassert>
+namespace tokenize::buffers {
+
+uint32_t symbol_table::intern(std::string_view name) {
+    if (const auto iter = ids.find(name); iter != ids.end()) {
+        return iter->second;
+    }
+    assert(names.size() < none);
+    const uint32_t id = names.size();
+    ids.emplace(names.emplace_back(name), id);
+    return id;
+}
+
+std::optional<uint32_t> symbol_table::find(std::string_view name) const {
+    if (const auto iter = ids.find(name); iter != ids.end()) {
+        return iter->second;
+    }
+    return std::nullopt;
+}
+
+bool token_buffer::push_back(const lexeme &l, std::string_view source) {
+    if (l.offset > max_input || l.length > max_input - l.offset) {
+        return false;
+    }
+    ids.push_back(uint16_t(l.id));
+    offsets.push_back(l.offset);
+    lengths.push_back(l.length);
+    symbols.push_back(is_symbol(l.id) ? table->intern(l.text(source)) : symbol_table::none);
+    return true;
+}
+
+void token_buffer::reserve(size_t n) {
+    ids.reserve(n), offsets.reserve(n), lengths.reserve(n), symbols.reserve(n);
+}
+
+void token_buffer::clear() { ids.clear(), offsets.clear(), lengths.clear(), symbols.clear(); }
+
+bool tokenize_all(view_reader &source, token_buffer &ts) {
+    if (source.view().size() > token_buffer::max_input) {
+        return false;
+    }
+    view_reader *reader = &source;
+    do {
+        lexeme l;
+        if (!tokens::tokenize(reader, l)) {
+            break;
+        }
+        if (!ts.push_back(l, source.view())) {
+            return false;
+        }
+    } while (1);
+    return true;
+}
+
+} // namespace tokenize::buffers
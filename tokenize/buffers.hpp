@@ -0,0 +1,72 @@
+#pragma once
+#include "readers.hpp"
+#include "tokens.hpp"
+#include <deque>
+#include <memory>
+#include <optional>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+namespace tokenize::buffers {
+using readers::view_reader;
+using tokens::lexeme, tokens::token_id;
+
+// 名前を密な32bitの番号に置き換える
+class symbol_table {
+    std::deque<std::string> names; // 番号 -> 名前(追加しても参照が無効にならない)
+    std::unordered_map<std::string_view, uint32_t> ids;
+
+public:
+    static constexpr uint32_t none = UINT32_MAX;
+
+    uint32_t intern(std::string_view name);
+    std::optional<uint32_t> find(std::string_view name) const;
+    std::string_view name(uint32_t id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+};
+
+// トークン列を項目ごとの配列に分けて持つ
+// token_idだけを走査する処理は1トークン2バイトしか触れない
+// 変数名と型キーワードはsymbol_tableの番号を持つ(それ以外はsymbol_table::none)
+class token_buffer {
+    std::vector<uint16_t> ids;
+    std::vector<uint32_t> offsets, lengths; // 入力は4GiB未満
+    std::vector<uint32_t> symbols;
+    std::shared_ptr<symbol_table> table;
+
+public:
+    // 複数のバッファで記号表を共有できる
+    token_buffer(std::shared_ptr<symbol_table> _table = std::make_shared<symbol_table>()) : table(_table) {}
+
+    // 位置と長さを32bitで持つので、これより大きな入力は扱えない
+    static constexpr size_t max_input = UINT32_MAX;
+
+    // 入力のmax_inputを超える範囲にかかる字句は追加せずにfalseを返す
+    bool push_back(const lexeme &l, std::string_view source);
+    void reserve(size_t n);
+    void clear();
+
+    size_t size() const { return ids.size(); }
+    bool empty() const { return ids.empty(); }
+    token_id id(size_t i) const { return token_id(ids[i]); }
+    uint32_t symbol(size_t i) const { return symbols[i]; }
+    lexeme at(size_t i) const { return lexeme{id(i), offsets[i], lengths[i]}; }
+
+    const std::vector<uint16_t> &get_ids() const { return ids; }
+    const std::vector<uint32_t> &get_offsets() const { return offsets; }
+    const std::vector<uint32_t> &get_lengths() const { return lengths; }
+    const std::vector<uint32_t> &get_symbols() const { return symbols; }
+    const symbol_table &get_table() const { return *table; }
+};
+
+// 変数名と型キーワードは記号表に登録する
+static inline bool is_symbol(token_id id) {
+    return id == token_id::variable || (token_id::type_bool <= id && id <= token_id::type_func);
+}
+
+// 入力がtoken_buffer::max_inputより大きければ何も読まずにfalseを返す
+bool tokenize_all(view_reader &source, token_buffer &ts);
+
+} // namespace tokenize::buffers
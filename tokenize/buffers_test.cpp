@@ -0,0 +1,70 @@
+#include "acutest.h"
+#include "buffers.hpp"
+
+using namespace tokenize::buffers;
+using tokenize::tokens::token;
+
+// symbol table
+void symbol_table_test() {
+    symbol_table table;
+    const uint32_t a = table.intern("alpha"), b = table.intern("beta");
+    TEST_ASSERT(a == 0 && b == 1);
+    TEST_ASSERT(table.intern(std::string("alpha")) == a);
+    TEST_ASSERT(table.find("beta") == b && !table.find("gamma"));
+    TEST_ASSERT(table.name(b) == "beta" && table.size() == 2);
+}
+
+// token buffer
+void token_buffer_test() {
+    const std::string src = "int x = x + 1; str y";
+    view_reader source(src);
+    token_buffer ts;
+    TEST_ASSERT(tokenize_all(source, ts));
+
+    // same as tokenize_all over tokens
+    std::vector<token> expect;
+    auto reader = tokenize::readers::make_view_reader(src);
+    TEST_ASSERT(tokenize::tokens::tokenize_all(reader, expect));
+    TEST_ASSERT(ts.size() == expect.size());
+    for (size_t i = 0; i < ts.size() && i < expect.size(); i++) {
+        TEST_CHECK(ts.id(i) == expect[i].id);
+        TEST_CHECK(ts.at(i).text(src) == expect[i].text);
+    }
+
+    // interned names
+    const symbol_table &table = ts.get_table();
+    TEST_ASSERT(ts.symbol(0) == table.find("int"));
+    TEST_ASSERT(ts.symbol(1) == ts.symbol(3) && table.name(ts.symbol(1)) == "x");
+    TEST_ASSERT(ts.symbol(2) == symbol_table::none);
+    TEST_ASSERT(table.size() == 4);
+}
+
+void token_buffer_shared_table_test() {
+    auto table = std::make_shared<symbol_table>();
+    token_buffer first(table), second(table);
+    view_reader a("foo bar"), b("bar baz");
+    TEST_ASSERT(tokenize_all(a, first) && tokenize_all(b, second));
+    TEST_ASSERT(first.symbol(1) == second.symbol(0));
+    TEST_ASSERT(table->size() == 3);
+}
+
+void token_buffer_limit_test() {
+    // offsets and lengths beyond 32 bits are refused, not truncated
+    const std::string src = "x";
+    token_buffer ts;
+    TEST_CHECK(ts.push_back(tokenize::tokens::lexeme{token_id::variable, 0, 1}, src));
+    TEST_CHECK(!ts.push_back(tokenize::tokens::lexeme{token_id::op_add, token_buffer::max_input, 1}, src));
+    TEST_CHECK(!ts.push_back(tokenize::tokens::lexeme{token_id::op_add, size_t(1) << 32, 0}, src));
+    TEST_CHECK(ts.push_back(tokenize::tokens::lexeme{token_id::op_add, token_buffer::max_input, 0}, src));
+    TEST_CHECK(ts.size() == 2 && ts.get_offsets().back() == UINT32_MAX);
+}
+
+TEST_LIST = {
+    // symbol table
+    {"symbol_table_test", symbol_table_test},
+    // token buffer
+    {"token_buffer_test", token_buffer_test},
+    {"token_buffer_shared_table_test", token_buffer_shared_table_test},
+    {"token_buffer_limit_test", token_buffer_limit_test},
+    // end
+    {nullptr, nullptr}};
@@ -0,0 +1,109 @@
+#include "incremental.hpp"
+#include <algorithm>
+namespace tokenize::incremental {
+using readers::tracking_reader, readers::position;
+using tokens::lexeme, tokens::boundary;
+
+namespace {
+
+// トークンの終端の位置
+position end_of(const token &t) {
+    position p = t.pos;
+    p.next(t.text);
+    return p;
+}
+
+// pの位置から一歩ずつ読み、stopが真を返すか打ち切るまでdocの末尾に追加する
+// pは最後に読んだトークンの終端になる
+template <class Stop> void lex(document &doc, std::string_view text, size_t reach, position &p, Stop stop) {
+    tracking_reader r(text);
+    tracking_reader *reader = &r;
+    reader->set_offset(p.offset);
+    while (!stop(reader->get_offset())) {
+        lexeme l;
+        boundary b;
+        const bool result = tokens::tokenize(reader, l, b);
+        reach = std::max(reach, b.reach);
+        doc.starts.push_back(b.start);
+        doc.reaches.push_back(reach);
+        if (!result) {
+            break;
+        }
+        p.next(text.substr(p.offset, l.offset - p.offset));
+        doc.tokens.push_back(tokens::make_token(l.id, p, std::string(l.text(text))));
+        p.next(l.text(text));
+    }
+}
+
+} // namespace
+
+document tokenize_document(std::string_view text) {
+    document doc;
+    position p;
+    lex(doc, text, 0, p, [](size_t) { return false; });
+    return doc;
+}
+
+change retokenize(document &doc, std::string &text, const edit &e) {
+    const size_t old_end = e.offset + e.erased, new_end = e.offset + e.inserted.size();
+
+    // 編集位置を調べた最初の一歩
+    // 見つからなければ、編集位置より前で字句解析に失敗しているので結果は変わらない
+    const size_t first = std::upper_bound(doc.reaches.begin(), doc.reaches.end(), e.offset) - doc.reaches.begin();
+    if (first == doc.starts.size()) {
+        text.replace(e.offset, e.erased, e.inserted);
+        return change{doc.tokens.size(), 0, 0};
+    }
+    const position restart = first == 0 ? position() : end_of(doc.tokens[first - 1]);
+
+    text.replace(e.offset, e.erased, e.inserted);
+
+    // 編集より後で開始位置が揃えば、その一歩以降は古い結果をずらしたものと同じになる
+    document fresh;
+    position p = restart;
+    size_t resync = doc.starts.size();
+    lex(fresh, text, first == 0 ? 0 : doc.reaches[first - 1], p, [&](size_t offset) {
+        if (offset < new_end) {
+            return false;
+        }
+        const size_t old = offset - new_end + old_end;
+        const auto iter = std::lower_bound(doc.starts.begin() + first, doc.starts.end(), old);
+        if (iter == doc.starts.end() || *iter != old) {
+            return false;
+        }
+        resync = iter - doc.starts.begin();
+        return true;
+    });
+
+    const change c{first, std::min(resync, doc.tokens.size()) - first, fresh.tokens.size()};
+    if (resync < doc.starts.size()) {
+        // 揃った位置の前後で行と、同じ行の桁をずらす
+        const position from = resync == first ? restart : end_of(doc.tokens[resync - 1]);
+        for (size_t i = resync; i < doc.tokens.size(); i++) {
+            position &q = doc.tokens[i].pos;
+            if (q.line == from.line) {
+                q.number = q.number - from.number + p.number;
+            }
+            q.line = q.line - from.line + p.line;
+            q.offset = q.offset - old_end + new_end;
+        }
+        size_t reach = fresh.reaches.empty() ? 0 : fresh.reaches.back();
+        for (size_t i = resync; i < doc.starts.size(); i++) {
+            doc.starts[i] = doc.starts[i] - old_end + new_end;
+            reach = std::max(reach, doc.reaches[i] - old_end + new_end);
+            doc.reaches[i] = reach;
+        }
+    }
+
+    const auto splice = [](auto &v, size_t from, size_t to, auto &w) {
+        to = std::min(to, v.size());
+        v.erase(v.begin() + from, v.begin() + to);
+        v.insert(v.begin() + from, std::make_move_iterator(w.begin()), std::make_move_iterator(w.end()));
+    };
+    splice(doc.tokens, first, resync, fresh.tokens);
+    splice(doc.starts, first, resync, fresh.starts);
+    splice(doc.reaches, first, resync, fresh.reaches);
+    return c;
+}
+
+} // namespace tokenize::incremental
@@ -0,0 +1,38 @@
+#pragma once
+#include "tokens.hpp"
+#include <stddef.h>
+#include <string>
+#include <string_view>
+#include <vector>
+namespace tokenize::incremental {
+using tokens::token;
+
+// 編集後に再解析できるよう、一歩ごとの境界の状態を添えたトークン列
+struct document {
+    std::vector<token> tokens;
+    // starts[i]はtokens[i]を読んだ一歩の開始位置で、末尾に解析を打ち切った一歩(失敗または終端)がある
+    std::vector<size_t> starts;
+    // reaches[i]は先頭からi番目の一歩までに調べた範囲の終端の最大値(単調増加)
+    std::vector<size_t> reaches;
+};
+
+document tokenize_document(std::string_view text);
+
+// text[offset, offset + erased)をinsertedで置き換える
+struct edit {
+    size_t offset = 0, erased = 0;
+    std::string_view inserted;
+};
+
+// 古いtokens[first, first + erased)が新しいtokens[first, first + inserted)になった
+struct change {
+    size_t first = 0, erased = 0, inserted = 0;
+};
+
+// textにeを適用し、docを編集後のtextをtokenize_allしたものと同じにする
+// 編集位置を調べた最初の一歩から読み直し、編集より後の古い一歩と開始位置が揃ったところで打ち切る
+// 以降のトークンは位置をずらすだけなので、字句解析の量は編集の大きさに比例する
+// (e.insertedはtextを指していてはならない)
+change retokenize(document &doc, std::string &text, const edit &e);
+
+} // namespace tokenize::incremental
@@ -0,0 +1,87 @@
+#include "acutest.h"
+#include "incremental.hpp"
+#include "tokenize.hpp"
+#include "tokens_testing.hpp"
+#include <random>
+
+using namespace tokenize;
+using tokenize::incremental::document, tokenize::incremental::edit, tokenize::incremental::change;
+
+void document_test() {
+    const std::string src = "int x = 1;\n/* c */ y";
+    const document doc = tokenize_document(src);
+    TEST_ASSERT(same(doc.tokens, lex(src)));
+    TEST_ASSERT(doc.starts.size() == doc.tokens.size() + 1);
+    TEST_ASSERT(std::is_sorted(doc.reaches.begin(), doc.reaches.end()));
+    TEST_CHECK(doc.reaches.back() == src.size() + 1); // 終端まで調べる
+}
+
+void retokenize_test() {
+    std::string src = "int x = 1;\nint y = 2;\nint z = 3;\n";
+    document doc = tokenize_document(src);
+
+    // "y" -> "yy" only replaces one token
+    change c = retokenize(doc, src, edit{15, 1, "yy"});
+    TEST_ASSERT(src == "int x = 1;\nint yy = 2;\nint z = 3;\n");
+    TEST_CHECK(same(doc.tokens, lex(src)));
+    TEST_CHECK(c.first == 6 && c.erased == 1 && c.inserted == 1);
+
+    // lookahead: "1." + "5" becomes a real
+    src = "a = 1.x;";
+    doc = tokenize_document(src);
+    c = retokenize(doc, src, edit{6, 1, "5"});
+    TEST_CHECK(same(doc.tokens, lex(src)));
+    TEST_CHECK(doc.tokens[2].id == token_id::real && doc.tokens[2].text == "1.5");
+
+    // opening a comment swallows the rest
+    src = "a b\nc d\n";
+    doc = tokenize_document(src);
+    c = retokenize(doc, src, edit{2, 0, "/*"});
+    TEST_CHECK(same(doc.tokens, lex(src)));
+    TEST_CHECK(c.first == 1 && doc.tokens.size() == 1);
+
+    // edit after a failure changes nothing
+    src = "a $ b";
+    doc = tokenize_document(src);
+    c = retokenize(doc, src, edit{5, 0, " c"});
+    TEST_CHECK(same(doc.tokens, lex(src)) && c.erased == 0 && c.inserted == 0);
+}
+
+void retokenize_random_test() {
+    const char *const fragments[] = {"int", " ", "\n", "\r\n", "x", "1", ".", "5", "e", "\"", "'", "/*", "*/", "//",
+                                     "=",   "+", ";",  "0x", "F", "_", "(", ")", "{", "}",  "\\", "$"};
+    std::mt19937 rng(1);
+    for (size_t round = 0; round < 200; round++) {
+        std::string src;
+        for (size_t i = 0; i < 60; i++) {
+            src += fragments[rng() % std::size(fragments)];
+        }
+        document doc = tokenize_document(src);
+        for (size_t step = 0; step < 30; step++) {
+            const size_t offset = rng() % (src.size() + 1);
+            const size_t erased = std::min<size_t>(rng() % 4, src.size() - offset);
+            std::string inserted;
+            for (size_t i = rng() % 3; i > 0; i--) {
+                inserted += fragments[rng() % std::size(fragments)];
+            }
+            const std::vector<token> before = doc.tokens;
+            const change c = retokenize(doc, src, edit{offset, erased, inserted});
+            const auto expect = lex(src);
+            TEST_ASSERT_(same(doc.tokens, expect), "round %zu step %zu", round, step);
+            TEST_ASSERT(doc.starts.size() == doc.tokens.size() + 1 && doc.reaches.size() == doc.starts.size());
+            // outside the changed range the tokens are the same up to shifting
+            TEST_ASSERT(c.first + c.erased <= before.size() && before.size() - c.erased + c.inserted == expect.size());
+            for (size_t i = 0; i < c.first; i++) {
+                TEST_CHECK(before[i].pos == expect[i].pos && before[i].text == expect[i].text);
+            }
+            for (size_t i = c.first + c.erased; i < before.size(); i++) {
+                TEST_CHECK(before[i].text == expect[i - c.erased + c.inserted].text);
+            }
+        }
+    }
+}
+
+TEST_LIST = {{"document_test", document_test},
+             {"retokenize_test", retokenize_test},
+             {"retokenize_random_test", retokenize_random_test},
+             {nullptr, nullptr}};
@@ -0,0 +1,206 @@
+#include "numbers.hpp"
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <limits>
+#include <string>
+namespace tokenize::numbers {
+
+bool integer_value::to_int64(int64_t &out) const {
+    const unsigned __int128 limit = negative ? (unsigned __int128)1 << 63 : ((unsigned __int128)1 << 63) - 1;
+    if (overflow || magnitude > limit) {
+        return false;
+    }
+    out = negative ? int64_t(-uint64_t(magnitude)) : int64_t(magnitude);
+    return true;
+}
+
+bool integer_value::to_uint64(uint64_t &out) const {
+    if (overflow || (negative && magnitude != 0) || magnitude > std::numeric_limits<uint64_t>::max()) {
+        return false;
+    }
+    out = uint64_t(magnitude);
+    return true;
+}
+
+namespace {
+
+// 符号と接頭辞を読み、基数を返す
+unsigned int read_prefix(std::string_view &text, bool &negative) {
+    negative = false;
+    if (!text.empty() && (text[0] == '+' || text[0] == '-')) {
+        negative = text[0] == '-';
+        text.remove_prefix(1);
+    }
+    if (text.size() >= 2 && text[0] == '0') {
+        switch (text[1]) {
+        case 'b':
+            return text.remove_prefix(2), 2;
+        case 'q':
+            return text.remove_prefix(2), 4;
+        case 'o':
+            return text.remove_prefix(2), 8;
+        case 'd':
+            return text.remove_prefix(2), 10;
+        case 'x':
+            return text.remove_prefix(2), 16;
+        }
+    }
+    return 10;
+}
+
+unsigned int digit_of(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    return (c | 0x20) - 'a' + 10;
+}
+
+// 10進の指数(桁区切りを含む)を読む
+// 大きすぎる指数はどのみち0か無限大になるので飽和させる
+int64_t read_exponent(std::string_view text) {
+    bool negative = false;
+    if (!text.empty() && (text[0] == '+' || text[0] == '-')) {
+        negative = text[0] == '-';
+        text.remove_prefix(1);
+    }
+    int64_t e = 0;
+    for (const char c : text) {
+        if (c != '_') {
+            e = std::min<int64_t>(e * 10 + (c - '0'), 1 << 24);
+        }
+    }
+    return negative ? -e : e;
+}
+
+// (bits + 端数) * 2^exp2 を最も近いdoubleに丸める(偶数丸め)
+// stickyは切り捨てた下位の桁に0でないものがあったか
+double make_double(uint64_t bits, int64_t exp2, bool sticky, bool &overflow) {
+    overflow = false;
+    if (bits == 0) {
+        return 0;
+    }
+    const int shift = std::countl_zero(bits);
+    bits <<= shift;
+    exp2 -= shift;
+    // 値は[2^e, 2^(e+1))にある
+    const int64_t e = exp2 + 63;
+    if (e > 1023) {
+        overflow = true;
+        return std::numeric_limits<double>::infinity();
+    }
+    // 残す桁数(非正規化数では少なくなる)
+    const int64_t precision = e >= -1022 ? 53 : 53 - (-1022 - e);
+    if (precision < 0) {
+        return 0;
+    }
+    const int dropped = 64 - precision;
+    uint64_t q = dropped < 64 ? bits >> dropped : 0;
+    const uint64_t rest = dropped < 64 ? bits & ((uint64_t(1) << dropped) - 1) : bits;
+    const uint64_t half = uint64_t(1) << (dropped - 1);
+    if (rest > half || (rest == half && (sticky || (q & 1)))) {
+        q++;
+    }
+    const double value = std::ldexp(double(q), int(e - precision + 1));
+    overflow = std::isinf(value);
+    return value;
+}
+
+} // namespace
+
+integer_value decode_integer(std::string_view text) {
+    integer_value v;
+    const unsigned int base = read_prefix(text, v.negative);
+    const unsigned __int128 max = ~(unsigned __int128)0;
+    for (const char c : text) {
+        if (c == '_') {
+            continue;
+        }
+        const unsigned int d = digit_of(c);
+        if (v.magnitude > (max - d) / base) {
+            v.overflow = true;
+            v.magnitude = max;
+            break;
+        }
+        v.magnitude = v.magnitude * base + d;
+    }
+    return v;
+}
+
+real_value decode_real(std::string_view text) {
+    real_value v;
+    bool negative;
+    const unsigned int base = read_prefix(text, negative);
+
+    if (base == 10) {
+        // 桁区切りを除いてfrom_charsで丸める(最も近い値になる)
+        char local[128];
+        std::string heap;
+        char *buffer = local;
+        if (text.size() > sizeof(local)) {
+            heap.resize(text.size());
+            buffer = heap.data();
+        }
+        char *last = std::copy_if(text.begin(), text.end(), buffer, [](char c) { return c != '_'; });
+        // 指数の桁がなければ(1.5e, 1.5e+)指数を無視する
+        if (last != buffer && (last[-1] == 'e' || last[-1] == 'E')) {
+            last--;
+        } else if (last - buffer >= 2 && (last[-1] == '+' || last[-1] == '-') && (last[-2] == 'e' || last[-2] == 'E')) {
+            last -= 2;
+        }
+        const auto [ptr, ec] = std::from_chars(buffer, last, v.value);
+        if (ec == std::errc::result_out_of_range) {
+            // 最上位の桁の位と指数から、大きすぎたか小さすぎたかを決める
+            char *marker = std::find_if(buffer, last, [](char c) { return c == 'e' || c == 'E'; });
+            char *dot = std::find(buffer, marker, '.');
+            char *top = std::find_if(buffer, marker, [](char c) { return c != '0' && c != '.'; });
+            const int64_t place = top < dot ? dot - top : -(top - dot - 1);
+            const int64_t exponent =
+                marker != last ? read_exponent(std::string_view(marker + 1, last - marker - 1)) : 0;
+            v.overflow = place + exponent > 0;
+            v.value = v.overflow ? std::numeric_limits<double>::infinity() : 0;
+        }
+        v.value = negative ? -v.value : v.value;
+        return v;
+    }
+
+    // 2の冪の基数は仮数のbit列をそのまま並べ、最後に一度だけ丸める
+    // (0xではeは桁なので指数はない)
+    const int k = std::countr_zero(base);
+    const size_t marker = base == 16 ? std::string_view::npos : text.find_first_of("eE");
+    const std::string_view digits = text.substr(0, marker);
+    uint64_t bits = 0;
+    int64_t exp2 = 0;
+    bool sticky = false, dot = false, leading = true;
+    for (const char c : digits) {
+        if (c == '_') {
+            continue;
+        }
+        if (c == '.') {
+            dot = true;
+            continue;
+        }
+        const unsigned int d = digit_of(c);
+        if (leading && d == 0) {
+            exp2 -= dot ? k : 0;
+            continue;
+        }
+        leading = false;
+        if (bits >> (64 - k) == 0) {
+            bits = bits << k | d;
+            exp2 -= dot ? k : 0;
+        } else {
+            sticky |= d != 0;
+            exp2 += dot ? 0 : k;
+        }
+    }
+    if (marker != std::string_view::npos) {
+        exp2 += k * read_exponent(text.substr(marker + 1));
+    }
+    v.value = make_double(bits, exp2, sticky, v.overflow);
+    v.value = negative ? -v.value : v.value;
+    return v;
+}
+
+} // namespace tokenize::numbers
@@ -0,0 +1,29 @@
+#pragma once
+#include <stdint.h>
+#include <string_view>
+namespace tokenize::numbers {
+
+// integerトークンの値
+struct integer_value {
+    unsigned __int128 magnitude = 0; // 絶対値(溢れたら最大値)
+    bool negative = false;
+    bool overflow = false; // 絶対値が128bitに収まらない
+
+    // 範囲に収まれば書き込む
+    bool to_int64(int64_t &) const;
+    bool to_uint64(uint64_t &) const;
+};
+
+// realトークンの値(最も近いdoubleに丸める)
+// 指数は仮数と同じ基数の冪(0b1.1e3は1.5 * 2^3)
+struct real_value {
+    double value = 0;
+    bool overflow = false; // doubleで表せず無限大になった
+};
+
+// 文法(parsers::integer, parsers::real)が読んだ文字列から値を求める
+// 符号、基数の接頭辞(0b, 0q, 0o, 0d, 0x)、桁区切りの'_'を扱う
+integer_value decode_integer(std::string_view text);
+real_value decode_real(std::string_view text);
+
+} // namespace tokenize::numbers
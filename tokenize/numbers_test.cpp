@@ -0,0 +1,129 @@
+#include "acutest.h"
+#include "numbers.hpp"
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <string>
+
+using namespace tokenize::numbers;
+
+static bool same(double x, double y) { return std::memcmp(&x, &y, sizeof(double)) == 0; }
+
+// integer
+void decode_integer_test() {
+    int64_t i;
+    uint64_t u;
+    TEST_CHECK(decode_integer("0").magnitude == 0);
+    TEST_CHECK(decode_integer("1_000_000").magnitude == 1000000);
+    TEST_CHECK(decode_integer("0b1010").magnitude == 10);
+    TEST_CHECK(decode_integer("0q33").magnitude == 15);
+    TEST_CHECK(decode_integer("0o777").magnitude == 511);
+    TEST_CHECK(decode_integer("0d0099").magnitude == 99);
+    TEST_CHECK(decode_integer("0xff_FF").magnitude == 0xffff);
+    TEST_CHECK(decode_integer("-0x10").to_int64(i) && i == -16);
+    TEST_CHECK(decode_integer("+42").to_int64(i) && i == 42);
+    TEST_CHECK(decode_integer("-9223372036854775808").to_int64(i) && i == INT64_MIN);
+    TEST_CHECK(!decode_integer("9223372036854775808").to_int64(i));
+    TEST_CHECK(decode_integer("18446744073709551615").to_uint64(u) && u == UINT64_MAX);
+    TEST_CHECK(!decode_integer("18446744073709551616").to_uint64(u));
+    TEST_CHECK(!decode_integer("-1").to_uint64(u));
+    TEST_CHECK(decode_integer("-0").to_uint64(u) && u == 0);
+}
+
+void decode_integer_overflow_test() {
+    // 2^128 - 1は収まり、2^128は溢れる
+    const integer_value max = decode_integer("0x" + std::string(32, 'f'));
+    TEST_CHECK(!max.overflow && max.magnitude == ~(unsigned __int128)0);
+    const integer_value over = decode_integer("0x1" + std::string(32, '0'));
+    TEST_CHECK(over.overflow && over.magnitude == ~(unsigned __int128)0);
+    TEST_CHECK(decode_integer("340282366920938463463374607431768211455").overflow == false);
+    TEST_CHECK(decode_integer("340282366920938463463374607431768211456").overflow);
+}
+
+// real
+void decode_real_test() {
+    TEST_CHECK(decode_real("1.5").value == 1.5);
+    TEST_CHECK(decode_real("-1.5").value == -1.5);
+    TEST_CHECK(decode_real("1_000.000_5").value == 1000.0005);
+    TEST_CHECK(decode_real("0d1.25e2").value == 125);
+    TEST_CHECK(decode_real("2.5E-1").value == 0.25);
+    TEST_CHECK(decode_real("1.5e").value == 1.5);
+    TEST_CHECK(decode_real("1.5e+").value == 1.5);
+    TEST_CHECK(decode_real("0.1").value == 0.1);
+    // 2の冪の基数は同じ基数の冪を掛ける
+    TEST_CHECK(decode_real("0b1.1").value == 1.5);
+    TEST_CHECK(decode_real("0b1.1e3").value == 12);
+    TEST_CHECK(decode_real("0q1.2e-1").value == 0.375);
+    TEST_CHECK(decode_real("0o7.4").value == 7.5);
+    TEST_CHECK(decode_real("-0x1f.8").value == -31.5);
+    TEST_CHECK(decode_real("0x1.e").value == 1.875); // 0xではeは桁
+    TEST_CHECK(same(decode_real("-0.0").value, -0.0));
+}
+
+void decode_real_limit_test() {
+    TEST_CHECK(decode_real("1.0e308").value == 1e308 && !decode_real("1.0e308").overflow);
+    const real_value inf = decode_real("1.0e309");
+    TEST_CHECK(std::isinf(inf.value) && inf.overflow);
+    TEST_CHECK(decode_real("-1.0e400").value == -INFINITY);
+    TEST_CHECK(same(decode_real("1.0e-400").value, 0.0) && !decode_real("1.0e-400").overflow);
+    TEST_CHECK(decode_real("0.000_3e-320").value == std::ldexp(1.0, -1074));
+    TEST_CHECK(decode_real("4.9e-324").value == std::ldexp(1.0, -1074));
+    TEST_CHECK(decode_real("0b1.0e1024").overflow);
+    TEST_CHECK(decode_real("0b1.0e1023").value == std::ldexp(1.0, 1023));
+    TEST_CHECK(decode_real("0b1.0e-1074").value == std::ldexp(1.0, -1074));
+    TEST_CHECK(decode_real("0b1.1e-1075").value == std::ldexp(1.0, -1074)); // 半分より大きいので切り上げ
+    TEST_CHECK(decode_real("0b1.0e-1075").value == 0);                     // ちょうど半分は偶数へ
+    TEST_CHECK(decode_real("0b0.000_000_1e-1000").value == std::ldexp(1.0, -1007));
+}
+
+// strtodと同じ値に丸めるか
+void decode_real_random_test() {
+    std::mt19937 rng(3);
+    const auto digits = [&](const char *alphabet, size_t base, size_t n) {
+        std::string s;
+        for (size_t i = 0; i < n; i++) {
+            s.push_back(alphabet[rng() % base]);
+        }
+        return s;
+    };
+    for (int i = 0; i < 20000; i++) {
+        // 10進
+        const std::string mantissa =
+            digits("0123456789", 10, 1 + rng() % 25) + "." + digits("0123456789", 10, 1 + rng() % 25);
+        const std::string text = mantissa + "e" + std::to_string(int(rng() % 700) - 350);
+        TEST_CHECK_(same(decode_real(text).value, std::strtod(text.c_str(), nullptr)), "%s", text.c_str());
+
+        // 16進(丸めの境界を作るため桁数を多めにする)
+        const std::string hex =
+            digits("0123456789abcdef", 16, 1 + rng() % 20) + "." + digits("0123456789abcdef", 16, 1 + rng() % 20);
+        const std::string c_hex = "0x" + hex + "p0";
+        TEST_CHECK_(same(decode_real("0x" + hex).value, std::strtod(c_hex.c_str(), nullptr)), "%s", hex.c_str());
+
+        // 2進は16進に並べ直して比べる
+        const std::string whole = "1" + digits("01", 2, 4 * (rng() % 20) + 3);
+        const std::string fraction = digits("01", 2, 4 * (rng() % 20));
+        const int e = int(rng() % 2200) - 1100;
+        std::string c_bin = "0x";
+        for (size_t j = 0; j < whole.size(); j += 4) {
+            c_bin.push_back("0123456789abcdef"[std::stoi(whole.substr(j, 4), nullptr, 2)]);
+        }
+        c_bin.push_back('.');
+        for (size_t j = 0; j < fraction.size(); j += 4) {
+            c_bin.push_back("0123456789abcdef"[std::stoi(fraction.substr(j, 4), nullptr, 2)]);
+        }
+        c_bin += "0p" + std::to_string(e);
+        const std::string bin = "0b" + whole + "." + fraction + "0e" + std::to_string(e);
+        TEST_CHECK_(same(decode_real(bin).value, std::strtod(c_bin.c_str(), nullptr)), "%s", bin.c_str());
+    }
+}
+
+TEST_LIST = {
+    // integer
+    {"decode_integer_test", decode_integer_test},
+    {"decode_integer_overflow_test", decode_integer_overflow_test},
+    // real
+    {"decode_real_test", decode_real_test},
+    {"decode_real_limit_test", decode_real_limit_test},
+    {"decode_real_random_test", decode_real_random_test},
+    // end
+    {nullptr, nullptr}};
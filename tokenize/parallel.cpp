@@ -0,0 +1,139 @@
+#include "parallel.hpp"
+#include "simd.hpp"
+#include <algorithm>
+#include <thread>
+namespace tokenize::parallel {
+using readers::view_reader, readers::position;
+using tokens::lexeme;
+
+namespace {
+
+// 断片[begin, end)を投機的に解析した結果
+struct chunk {
+    size_t begin = 0, end = 0;
+    std::vector<lexeme> lexemes = {};
+    std::vector<size_t> starts = {}; // starts[i]はlexemes[i]を読み始めた位置(直前のトークンの終端)
+    size_t last = 0;                 // 解析を打ち切った位置
+    bool failed = false;             // lastで字句解析に失敗した
+    size_t newlines = 0;             // [begin, end)の改行の数
+};
+
+void speculate(std::string_view source, chunk &c) {
+    view_reader r(source);
+    view_reader *reader = &r;
+    reader->set_offset(c.begin);
+    // 終端を越えるトークンも最後まで読む
+    while (reader->get_offset() < c.end) {
+        const size_t start = reader->get_offset();
+        lexeme l;
+        if (!tokens::tokenize(reader, l)) {
+            reader->set_offset(start);
+            c.failed = true;
+            break;
+        }
+        c.starts.push_back(start);
+        c.lexemes.push_back(l);
+    }
+    c.last = reader->get_offset();
+
+    const char *const first = source.data() + c.begin, *const last = source.data() + c.end;
+    for (const char *iter = first; (iter = simd::find_either(iter, last, '\n', '\r')) != last; iter++) {
+        c.newlines++;
+    }
+}
+
+// 断片の先頭(改行の直後)の位置から進めながらトークンに変換する
+void materialize(std::string_view source, position p, const lexeme *first, const lexeme *last, token *out) {
+    for (; first != last; first++, out++) {
+        p.next(source.substr(p.offset, first->offset - p.offset));
+        *out = tokens::make_token(first->id, p, std::string(first->text(source)));
+    }
+}
+
+} // namespace
+
+bool tokenize_parallel(std::string_view source, std::vector<token> &ts, size_t n_threads) {
+    n_threads = std::max<size_t>(1, std::min(n_threads, source.size()));
+
+    // 改行の直後で分割する
+    std::vector<chunk> chunks;
+    for (size_t begin = 0; begin < source.size() || chunks.empty();) {
+        size_t end = std::max(begin + 1, source.size() * (chunks.size() + 1) / n_threads);
+        if (end >= source.size()) {
+            end = source.size();
+        } else {
+            const char *const newline = simd::find_either(source.data() + end - 1, source.data() + source.size(), '\n', '\r');
+            end = std::min(source.size(), size_t(newline - source.data()) + 1);
+        }
+        chunks.push_back(chunk{begin, end});
+        begin = end;
+    }
+
+    // 投機的に解析する
+    {
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < chunks.size(); i++) {
+            workers.emplace_back(speculate, source, std::ref(chunks[i]));
+        }
+        speculate(source, chunks[0]);
+        for (auto &worker : workers) {
+            worker.join();
+        }
+    }
+
+    // 本来の境界を辿りながら繋ぐ
+    std::vector<lexeme> ls;
+    view_reader r(source);
+    view_reader *reader = &r;
+    size_t current = 0;
+    bool failed = false;
+    for (const chunk &c : chunks) {
+        while (!failed && current < c.end) {
+            const auto iter = std::lower_bound(c.starts.begin(), c.starts.end(), current);
+            if (iter != c.starts.end() && *iter == current) {
+                // 一致したので以降は投機的な結果と同じになる
+                ls.insert(ls.end(), c.lexemes.begin() + (iter - c.starts.begin()), c.lexemes.end());
+                current = c.last, failed = c.failed;
+                break;
+            }
+            if (current == c.last && c.failed) {
+                failed = true;
+                break;
+            }
+            // 一致するまで逐次に解析し直す
+            reader->set_offset(current);
+            lexeme l;
+            if (!tokens::tokenize(reader, l)) {
+                failed = true;
+                break;
+            }
+            ls.push_back(l);
+            current = reader->get_offset();
+        }
+    }
+
+    // 断片ごとに並列にトークンへ変換する
+    const size_t base = ts.size();
+    ts.resize(base + ls.size());
+    {
+        std::vector<std::thread> workers;
+        size_t line = 0;
+        for (const chunk &c : chunks) {
+            const auto first = std::lower_bound(ls.begin(), ls.end(), c.begin,
+                                                [](const lexeme &l, size_t offset) { return l.offset < offset; });
+            const auto last = std::lower_bound(first, ls.end(), c.end,
+                                               [](const lexeme &l, size_t offset) { return l.offset < offset; });
+            if (first != last) {
+                workers.emplace_back(materialize, source, position(c.begin, line, 0), &*first, &*first + (last - first),
+                                     ts.data() + base + (first - ls.begin()));
+            }
+            line += c.newlines;
+        }
+        for (auto &worker : workers) {
+            worker.join();
+        }
+    }
+    return true;
+}
+
+} // namespace tokenize::parallel
@@ -0,0 +1,15 @@
+#pragma once
+#include "tokens.hpp"
+#include <stddef.h>
+#include <string_view>
+#include <vector>
+namespace tokenize::parallel {
+using tokens::token;
+
+// sourceを改行位置でn_threads個に分けて並列に字句解析する
+// 各断片は先頭から投機的に解析し、直前の断片から続く本来の境界と一致したところで繋ぐ
+// (コメントや文字列の途中から始まった断片は一致するまで逐次に解析し直す)
+// 結果はtokenize_allと同一で、tsの末尾に追加する
+bool tokenize_parallel(std::string_view source, std::vector<token> &ts, size_t n_threads);
+
+} // namespace tokenize::parallel
@@ -0,0 +1,56 @@
+#include "acutest.h"
+#include "parallel.hpp"
+#include "tokenize.hpp"
+#include "tokens_testing.hpp"
+#include <random>
+
+using namespace tokenize;
+using tokenize::parallel::tokenize_parallel;
+
+// 複数行にまたがるコメントや文字列を含む入力を作る
+static std::string generate(unsigned seed, size_t n) {
+    const char *const fragments[] = {"int x = 1;\n", "/* multi\nline\ncomment */", "\"a\\\"\nb\"", "\"\"\"tri\n\"ple\n\"\"\"",
+                                     "// line comment\n", "y += 0x1F_FF;\r\n", "'\\n'", "\n", " ", "func f() {\n}\n",
+                                     "1.5e10", "true", "\t"};
+    std::mt19937 rng(seed);
+    std::string s;
+    while (s.size() < n) {
+        s += fragments[rng() % std::size(fragments)];
+    }
+    return s;
+}
+
+void parallel_same_test() {
+    for (unsigned seed = 0; seed < 20; seed++) {
+        const std::string src = generate(seed, 2000);
+        const auto expect = lex(src);
+        for (size_t n = 1; n <= 16; n++) {
+            std::vector<token> ts;
+            TEST_ASSERT(tokenize_parallel(src, ts, n));
+            TEST_CHECK_(same(ts, expect), "seed %u threads %zu", seed, n);
+        }
+    }
+}
+
+void parallel_failure_test() {
+    // 途中で字句解析に失敗する入力
+    const std::string src = "a b c\nd e $ f\ng h\ni j\n";
+    const auto expect = lex(src);
+    TEST_ASSERT(expect.size() == 5);
+    for (size_t n = 1; n <= 8; n++) {
+        std::vector<token> ts;
+        TEST_ASSERT(tokenize_parallel(src, ts, n));
+        TEST_CHECK(same(ts, expect));
+    }
+}
+
+void parallel_empty_test() {
+    std::vector<token> ts;
+    TEST_ASSERT(tokenize_parallel("", ts, 4) && ts.empty());
+    TEST_ASSERT(tokenize_parallel("  \n/* */\n", ts, 4) && ts.empty());
+}
+
+TEST_LIST = {{"parallel_same_test", parallel_same_test},
+             {"parallel_failure_test", parallel_failure_test},
+             {"parallel_empty_test", parallel_empty_test},
+             {nullptr, nullptr}};
@@ -1,138 +1,26 @@
 #include "parsers.hpp"
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <iostream>
-#include <map>
-#include <unordered_set>
 namespace tokenize::parsers {
 
-atom::atom(char c) { match.set((unsigned char)c); }
-atom::atom(std::initializer_list<char> items) {
-    for (auto item : items) {
-        match.set((unsigned char)item);
+size_t atom::span(std::string_view sv) const {
+    if (cls.valid) {
+        return cls.span(sv.data(), sv.data() + sv.size());
     }
-}
-
-atom::atom(std::string_view items) {
-    for (auto item : items) {
-        match.set((unsigned char)item);
-    }
-}
-
-bool atom::operator()(reader_ptr &reader, std::string &s) const {
-    const auto peek = reader->peek();
-    if (!peek || !match.test((unsigned int)*peek)) {
-        return false;
-    }
-
-    reader->next(), s.push_back(*peek);
-    return true;
-}
-
-atom range(unsigned char first, unsigned char last) {
-    match_t m;
-    assert(first <= last);
-    for (size_t i = first; i <= last; i++) {
-        m.set(i);
-    }
-    return m;
-}
-
-atom operator+(const atom &x, const atom &y) { return atom(x.get_match() | y.get_match()); }
-atom operator-(const atom &x, const atom &y) { return atom(x.get_match() & ~y.get_match()); }
-
-// 整数関係
-atom digit(unsigned int base) {
-    match_t m;
-
-    unsigned char i = 0;
-    // 0~9
-    for (; i < base && i < 10; i++) {
-        m.set('0' + i);
-    }
-    // 10~
-    for (; i < base; i++) {
-        m.set('a' + i - 10);
-        m.set('A' + i - 10);
-    }
-    return atom(m);
-}
-
-bool multi::operator()(reader_ptr &reader, std::string &s) const {
-    for (const char c : keyword) {
-        const auto peek = reader->peek();
-        if (!peek || *peek != c) {
-            return false;
-        }
-        reader->next(), s.push_back(*peek);
-    }
-
-    return true;
-}
-
-static inline std::unordered_map<std::string, bool> table_from_keywords(const std::vector<std::string> &keywords) {
-    std::unordered_map<std::string, bool> table;
-    // 部分文字列を書き出す
-    for (const std::string &keyword : keywords) {
-        for (size_t i = 0; i < keyword.length(); i++) {
-            table[keyword.substr(0, i)] = false;
-        }
+    size_t n = 0;
+    for (; n < sv.size() && match.test((unsigned char)sv[n]); n++) {
     }
-    // 完全一致文字列を書き出す
-    for (const std::string &keyword : keywords) {
-        table[keyword] = true;
-    }
-
-    return table;
+    return n;
 }
 
-multi_list::multi_list(const std::vector<std::string> &_keywords) : table(table_from_keywords(_keywords)) {}
-
-bool multi_list::operator()(reader_ptr &reader, std::string &s) const {
-
-    bool is_rollbackable = false;
-    std::string rollback_string;
-    position rollback_position;
-
-    std::string match;
-    do {
-        bool is_failed;
-        do {
-            auto peek = reader->peek();
-            if (!peek) {
-                is_failed = true;
-                break;
-            }
-            match.push_back(*peek);
-
-            auto iter = table.find(match);
-            if (iter == table.end()) {
-                is_failed = true;
-                break;
-            }
-
-            reader->next();
-            if (iter->second) {
-                // save as rollback
-                is_rollbackable = true;
-                rollback_position = reader->get_position();
-                rollback_string = match;
-            }
-            is_failed = false;
-        } while (0);
-
-        if (is_failed) {
-            if (!is_rollbackable) {
-                return false;
-            }
-            reader->set_position(rollback_position);
-            s = rollback_string;
-            return true;
-        }
-
-    } while (1);
-
-    return false;
+uint32_t make_memo_id() {
+    // 組み込みの文法が固定で使う番号の後から振る(番号はmemo_tableのキーの16bitに収める)
+    static std::atomic<uint32_t> next = reserved_memo_ids;
+    const uint32_t id = next++;
+    assert(id < (1u << 16));
+    return id;
 }
 
 } // namespace tokenize::parsers
\ No newline at end of file
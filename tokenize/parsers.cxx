@@ -1,7 +1,114 @@
 #pragma once
 namespace tokenize::parsers {
 
-template <class R, class L> bool chain<R, L>::operator()(reader_ptr &reader, std::string &s) const {
+// 読み進めてから失敗したことをreaderの受け取り先に書き出す(受け取り先がなければ捨てる)
+template <reader_handle Reader>
+static inline void diagnose(Reader &reader, diagnostic::kind_t kind, diagnostic::combinator_t combinator,
+                            size_t offset) {
+    if constexpr (requires { reader->get_diagnostics(); }) {
+        if (readers::diagnostic_sink *sink = reader->get_diagnostics()) {
+            sink->report(diagnostic{kind, combinator, offset, reader->get_offset()});
+        }
+    }
+}
+
+template <reader_handle Reader, text_sink S> bool atom::operator()(Reader &reader, S &s) const {
+    const auto peek = reader->peek();
+    if (!peek || !match.test((unsigned char)*peek)) {
+        return false;
+    }
+
+    reader->next(), s.push_back(*peek);
+    return true;
+}
+
+template <reader_handle Reader, text_sink S> bool multi::operator()(Reader &reader, S &s) const {
+    for (const char c : keyword) {
+        const auto peek = reader->peek();
+        if (!peek || *peek != c) {
+            return false;
+        }
+        reader->next(), s.push_back(*peek);
+    }
+
+    return true;
+}
+
+constexpr multi_list::multi_list(std::span<const std::string_view> _keywords) : keyword_count(_keywords.size()) {
+    if (keyword_count > max_keywords) {
+        throw std::length_error("multi_list: too many keywords");
+    }
+    std::copy(_keywords.begin(), _keywords.end(), keywords.begin());
+
+    // キーワードに現れる文字だけを文字クラスに割り当てる
+    size_t class_count = 1;
+    for (const std::string_view keyword : get_keywords()) {
+        for (const char c : keyword) {
+            if (classes[(unsigned char)c] == 0) {
+                classes[(unsigned char)c] = class_count++;
+            }
+        }
+    }
+    if (class_count > max_classes) {
+        throw std::length_error("multi_list: too many distinct characters");
+    }
+
+    // トライを作る(0番は根で、どこからも遷移しない)
+    accepts.fill(-1);
+    size_t state_count = 1;
+    for (size_t i = 0; i < keyword_count; i++) {
+        size_t state = 0;
+        for (const char c : keywords[i]) {
+            const size_t index = state * max_classes + classes[(unsigned char)c];
+            if (transitions[index] == 0) {
+                if (state_count == max_states) {
+                    throw std::length_error("multi_list: keywords too long");
+                }
+                transitions[index] = state_count++;
+            }
+            state = transitions[index];
+        }
+        if (accepts[state] < 0) {
+            accepts[state] = i;
+        }
+    }
+}
+
+template <reader_handle Reader, text_sink S> int multi_list::match(Reader &reader, S &s) const {
+    const checkpoint keep(reader);
+    const size_t length = s.size();
+
+    // 最後に一致したキーワード
+    int matched = accepts[0];
+    size_t matched_offset = keep.get_offset(), matched_length = length;
+
+    size_t state = 0;
+    while (const auto peek = reader->peek()) {
+        state = transitions[state * max_classes + classes[(unsigned char)*peek]];
+        if (state == 0) {
+            break;
+        }
+        reader->next(), s.push_back(*peek);
+        if (accepts[state] >= 0) {
+            matched = accepts[state];
+            matched_offset = reader->get_offset(), matched_length = s.size();
+        }
+    }
+
+    if (matched < 0) {
+        keep.restore();
+        s.resize(length);
+        return -1;
+    }
+    // rollback
+    reader->set_offset(matched_offset);
+    s.resize(matched_length);
+    return matched;
+}
+
+template <parser R, parser L>
+template <reader_handle Reader, text_sink S>
+bool chain<R, L>::operator()(Reader &reader, S &s) const {
 
     if (!right(reader, s)) {
         return false;
@@ -11,21 +118,40 @@ template <class R, class L> bool chain<R, L>::operator()(reader_ptr &reader, std
 }
 
 template <parser T>
-repeat_range<T>::repeat_range(const T &_parser, unsigned int _min, unsigned int _max)
+constexpr repeat_range<T>::repeat_range(const T &_parser, unsigned int _min, unsigned int _max)
     : parser(_parser), min(_min), max(_max) {
     assert(min <= max);
 }
 
-template <parser T> bool repeat_range<T>::operator()(reader_ptr &reader, std::string &s) const {
-    int count = 0;
+template <parser T>
+template <reader_handle Reader, text_sink S>
+bool repeat_range<T>::operator()(Reader &reader, S &s) const {
+    unsigned int count = 0;
+
+    // 文字クラスの繰り返しは連続したバッファをまとめて走査する
+    if constexpr (std::is_same_v<T, atom>) {
+        while (count < max) {
+            const std::string_view window = reader->window();
+            const size_t n = std::min<size_t>(parser.span(window), max - count);
+            if (n == 0) {
+                break;
+            }
+            s.append(window.data(), n);
+            reader->set_offset(reader->get_offset() + n);
+            count += n;
+            if (n < window.size()) {
+                break;
+            }
+        }
+    }
 
     // min
     {
-        const position pos = reader->get_position();
+        const size_t offset = reader->get_offset();
         for (; count < min; count++) {
             if (!parser(reader, s)) {
-                if (pos != reader->get_position()) {
-                    std::cerr << "overrun (repeat min)" << std::endl;
+                if (offset != reader->get_offset()) {
+                    diagnose(reader, diagnostic::overrun_repeat_min, diagnostic::repeat_range, offset);
                 }
                 return false;
             }
@@ -34,10 +160,10 @@ template <parser T> bool repeat_range<T>::operator()(reader_ptr &reader, std::st
 
     // ~max
     for (; count < max; count++) {
-        const position pos = reader->get_position();
+        const size_t offset = reader->get_offset();
         if (!parser(reader, s)) {
-            if (pos != reader->get_position()) {
-                std::cerr << "overrun (repeat max)" << std::endl;
+            if (offset != reader->get_offset()) {
+                diagnose(reader, diagnostic::overrun_repeat_max, diagnostic::repeat_range, offset);
             }
             return true;
         }
@@ -45,47 +171,100 @@ template <parser T> bool repeat_range<T>::operator()(reader_ptr &reader, std::st
     return true;
 }
 
-template <parser R, parser L> bool sum<R, L>::operator()(reader_ptr &reader, std::string &out) const {
+template <parser R, parser L>
+constexpr sum<R, L>::sum(const R &_right, const L &_left)
+    : right(_right), left(_left), right_first(first_of(_right)), left_first(first_of(_left)) {}
+
+// 先頭の文字からpが成功しえないと分かる
+static inline bool cannot_start(const first_t &f, const std::optional<char> &peek) {
+    return !f.nullable && (!peek || !f.match.test((unsigned char)*peek));
+}
+
+template <parser R, parser L>
+template <reader_handle Reader, text_sink S>
+bool sum<R, L>::operator()(Reader &reader, S &out) const {
+    const auto peek = reader->peek();
+    if (cannot_start(right_first, peek)) {
+        return !cannot_start(left_first, peek) && left(reader, out);
+    }
+
     // store
-    const auto keep = reader->get_position();
+    const size_t keep = reader->get_offset();
 
     if (right(reader, out)) {
         return true;
     }
     // error check
-    if (keep != reader->get_position()) {
-        std::cerr << "overrun" << std::endl;
+    if (keep != reader->get_offset()) {
+        diagnose(reader, diagnostic::overrun, diagnostic::sum, keep);
         return false;
     }
 
-    return left(reader, out);
+    return !cannot_start(left_first, peek) && left(reader, out);
 }
 
-template <class P> template <class T> bool attempt<P>::operator()(reader_ptr &reader, T &out) const {
-    // store
-    const T out_keep = out;
-    const position p_keep = reader->get_position();
-    // parse
-    if (parser(reader, out)) {
-        return true;
+template <class P>
+template <reader_handle Reader, class T>
+bool attempt<P>::operator()(Reader &reader, T &out) const {
+    const checkpoint keep(reader);
+    if constexpr (text_sink<T>) {
+        // 書き出しは末尾への追加だけなので長さを戻せばよい
+        const size_t length = out.size();
+        if (parser(reader, out)) {
+            return true;
+        }
+        out.resize(length);
+    } else {
+        // store
+        const T out_keep = out;
+        // parse
+        if (parser(reader, out)) {
+            return true;
+        }
+        // restore
+        out = out_keep;
     }
-    // restore
-    out = out_keep;
-    reader->set_position(p_keep);
+#if TOKENIZE_PROFILE
+    profile::rewind(reader->get_offset() - keep.get_offset());
+#endif
+    keep.restore();
     return false;
 }
 
+template <class T> template <class P> alternative<T>::alternative(const P &_parser) : parser(_parser), first(first_of(_parser)) {}
+
+template <class T> void sigma<T>::build() {
+    dispatch.fill(0);
+    for (size_t i = 0; i < parsers.size() && i < 64; i++) {
+        const first_t &first = parsers[i].first;
+        for (size_t c = 0; c < 256; c++) {
+            if (first.nullable || first.match.test(c)) {
+                dispatch[c] |= uint64_t(1) << i;
+            }
+        }
+        if (first.nullable) {
+            dispatch[256] |= uint64_t(1) << i;
+        }
+    }
+}
+
 template <class T> bool sigma<T>::operator()(reader_ptr &reader, T &out) const {
     // store
-    const position keep = reader->get_position();
+    const size_t keep = reader->get_offset();
 
-    for (const auto &parser : parsers) {
-        if (parser(reader, out)) {
+    // 先頭の文字で始まりうる選択肢だけを順に試す
+    const auto peek = reader->peek();
+    const uint64_t mask = dispatch[peek ? (unsigned char)*peek : 256];
+    for (size_t i = 0; i < parsers.size(); i++) {
+        if (i < 64 && !(mask >> i & 1)) {
+            continue;
+        }
+        if (parsers[i].parser(reader, out)) {
             return true;
         }
         // error check
-        if (keep != reader->get_position()) {
-            std::cerr << "overrun" << std::endl;
+        if (keep != reader->get_offset()) {
+            diagnose(reader, diagnostic::overrun, diagnostic::sigma, keep);
             return false;
         }
     }
@@ -93,11 +272,130 @@ template <class T> bool sigma<T>::operator()(reader_ptr &reader, T &out) const {
     return false;
 }
 
-template <parser B, parser I, parser E> bool bracket<B, I, E>::operator()(reader_ptr &reader, std::string &out) const {
+template <class... Ps> constexpr static_sigma<Ps...>::static_sigma(const Ps &..._parsers) : parsers(_parsers...) {
+    const first_t firsts[] = {first_of(_parsers)...};
+    dispatch.fill(0);
+    for (size_t i = 0; i < sizeof...(Ps); i++) {
+        for (size_t c = 0; c < 256; c++) {
+            if (firsts[i].nullable || firsts[i].match.test(c)) {
+                dispatch[c] |= uint64_t(1) << i;
+            }
+        }
+        if (firsts[i].nullable) {
+            dispatch[256] |= uint64_t(1) << i;
+        }
+    }
+}
+
+// I番目の選択肢を試し、打ち切るならtrueを返す
+template <class... Ps>
+template <size_t I, reader_handle Reader, class T>
+bool static_sigma<Ps...>::attempt_at(Reader &reader, T &out, uint64_t mask, size_t keep, bool &matched) const {
+    if (!(mask >> I & 1)) {
+        return false;
+    }
+    if (std::get<I>(parsers)(reader, out)) {
+        matched = true;
+        return true;
+    }
+    // error check
+    if (keep != reader->get_offset()) {
+        diagnose(reader, diagnostic::overrun, diagnostic::static_sigma, keep);
+        return true;
+    }
+    return false;
+}
+
+template <class... Ps>
+template <reader_handle Reader, class T>
+bool static_sigma<Ps...>::operator()(Reader &reader, T &out) const {
+    // store
+    const size_t keep = reader->get_offset();
+
+    const auto peek = reader->peek();
+    const uint64_t mask = dispatch[peek ? (unsigned char)*peek : 256];
+    bool matched = false;
+    [&]<size_t... I>(std::index_sequence<I...>) {
+        (attempt_at<I>(reader, out, mask, keep, matched) || ...);
+    }(std::index_sequence_for<Ps...>());
+    return matched;
+}
+
+template <class P> memo<P>::memo(const P &_parser) : parser(_parser), id(make_memo_id()) {}
+
+template <class P>
+template <reader_handle Reader, text_sink S>
+bool memo<P>::operator()(Reader &reader, S &out) const {
+    if constexpr (requires { reader->get_memo(); }) {
+        if (readers::memo_table *table = reader->get_memo()) {
+            const size_t offset = reader->get_offset();
+            if (const auto *e = table->find(id, offset)) {
+                // 読んだ範囲をそのまま書き出す(失敗した場合も読み進めた分は書き出している)
+                const size_t n = e->end - offset;
+                if (const std::string_view window = reader->window(); window.size() >= n) {
+                    out.append(window.data(), n);
+                    reader->set_offset(e->end);
+                } else {
+                    for (size_t i = 0; i < n; i++) {
+                        out.push_back(*reader->next());
+                    }
+                }
+                return e->result;
+            }
+            const bool result = parser(reader, out);
+            table->insert(id, offset, reader->get_offset(), result);
+            return result;
+        }
+    }
+    return parser(reader, out);
+}
+
+#if TOKENIZE_PROFILE
+template <profile::name_t Name, class P>
+template <reader_handle Reader, class T>
+bool probe<Name, P>::operator()(Reader &reader, T &out) const {
+    profile::counter &c = profile::counter_of<Name>;
+    profile::enroll(c);
+    profile::counter *const outer = std::exchange(profile::current, &c);
+    const size_t offset = reader->get_offset();
+    const uint64_t start = profile::now();
+    const bool result = parser(reader, out);
+    profile::add(c.cycles, profile::now() - start);
+    profile::add(c.calls, 1);
+    profile::add(result ? c.successes : c.failures, 1);
+    if (result) {
+        profile::add(c.consumed, reader->get_offset() - offset);
+    }
+    profile::current = outer;
+    return result;
+}
+#endif
+
+template <parser B, parser I, parser E>
+constexpr simd::char_class bracket<B, I, E>::skippable(const I &inner, const E &end) {
+    const std::optional<match_t> stops = stops_of(end);
+    if (!stops) {
+        return simd::char_class();
+    }
+    const match_t m = single_of(inner) & ~*stops;
+    return m.any() ? simd::char_class(m) : simd::char_class();
+}
+
+template <parser B, parser I, parser E>
+template <reader_handle Reader, text_sink S>
+bool bracket<B, I, E>::operator()(Reader &reader, S &out) const {
     if (!begin(reader, out)) {
         return false;
     }
     do {
+        // endが失敗してinnerが1文字読むだけの並びは、連続したバッファからまとめて書き出す
+        if (skip.valid) {
+            const std::string_view window = reader->window();
+            if (const size_t n = skip.span(window.data(), window.data() + window.size()); n > 0) {
+                out.append(window.data(), n);
+                reader->set_offset(reader->get_offset() + n);
+            }
+        }
         if (end(reader, out)) {
             return true;
         }
@@ -106,4 +404,75 @@ template <parser B, parser I, parser E> bool bracket<B, I, E>::operator()(reader
     return false;
 }
 
+template <class R, class L> constexpr first_t first_of(const chain<R, L> &c) {
+    const first_t right = first_of(c.get_right());
+    if (!right.nullable) {
+        return right;
+    }
+    const first_t left = first_of(c.get_left());
+    return first_t{right.match | left.match, left.nullable};
+}
+
+template <class T> constexpr first_t first_of(const repeat_range<T> &r) {
+    const first_t f = first_of(r.get_parser());
+    return first_t{f.match, f.nullable || r.get_min() == 0};
+}
+
+template <class P> constexpr first_t first_of(const attempt<P> &a) { return first_of(a.get_parser()); }
+
+template <class P> constexpr first_t first_of(const memo<P> &m) { return first_of(m.get_parser()); }
+
+template <profile::name_t Name, class P> constexpr first_t first_of(const probe<Name, P> &p) {
+    return first_of(p.get_parser());
+}
+
+template <class R, class L> constexpr first_t first_of(const sum<R, L> &s) {
+    const first_t right = first_of(s.get_right()), left = first_of(s.get_left());
+    return first_t{right.match | left.match, right.nullable || left.nullable};
+}
+
+template <class T> first_t first_of(const sigma<T> &s) {
+    first_t f;
+    for (const auto &alternative : s.get_parsers()) {
+        f.match |= alternative.first.match;
+        f.nullable |= alternative.first.nullable;
+    }
+    return f;
+}
+
+template <class... Ps> constexpr first_t first_of(const static_sigma<Ps...> &s) {
+    first_t f;
+    std::apply(
+        [&f](const auto &...parsers) {
+            ((f.match |= first_of(parsers).match, f.nullable |= first_of(parsers).nullable), ...);
+        },
+        s.get_parsers());
+    return f;
+}
+
+template <class R, class L> constexpr match_t single_of(const sum<R, L> &s) {
+    // 右が読めない文字だけ左を試す
+    const first_t right = first_of(s.get_right());
+    if (right.nullable) {
+        return single_of(s.get_right());
+    }
+    return single_of(s.get_right()) | (single_of(s.get_left()) & ~right.match);
+}
+
+template <class R, class L> constexpr std::optional<match_t> stops_of(const sum<R, L> &s) {
+    const std::optional<match_t> right = stops_of(s.get_right()), left = stops_of(s.get_left());
+    if (!right || !left) {
+        return std::nullopt;
+    }
+    return *right | *left;
+}
+
+template <class B, class I, class E> constexpr first_t first_of(const bracket<B, I, E> &b) {
+    const first_t begin = first_of(b.get_begin());
+    if (begin.nullable) {
+        return first_t{~match_t(), true};
+    }
+    return begin;
+}
+
 } // namespace tokenize::parsers
@@ -1,78 +1,172 @@
 #pragma once
 
+#include "profile.hpp"
 #include "readers.hpp"
+#include "simd.hpp"
 #include <algorithm>
+#include <array>
 #include <assert.h>
-#include <bitset>
 #include <climits>
 #include <concepts>
 #include <functional>
 #include <iostream>
 #include <memory>
 #include <optional>
+#include <span>
+#include <stdexcept>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 namespace tokenize::parsers {
 
-using readers::reader_ptr, readers::position;
+using readers::reader_ptr, readers::reader_handle, readers::position, readers::checkpoint, readers::diagnostic;
 
+// パーサが読んだ文字を書き出す先
+// 読んだ文字は常に入力の連続した範囲なので、範囲だけ記録するspanを使えば文字列を確保しない
+template <class S>
+concept text_sink = requires(S s, const S cs, char c, const char *p, size_t n) {
+    s.push_back(c);
+    s.append(p, n);
+    { cs.size() } -> std::convertible_to<size_t>;
+    s.resize(n);
+};
+
+// 入力上の範囲[offset, offset + length)だけを記録する
+struct span {
+    size_t offset = 0, length = 0;
+
+    void push_back(char) { length++; }
+    void append(const char *, size_t n) { length += n; }
+    size_t size() const { return length; }
+    void resize(size_t n) { length = n; }
+    std::string_view view(std::string_view source) const { return source.substr(offset, length); }
+};
+
+// 各パーサは任意のreader_handleに対してテンプレートとして実体化される
+// reader_ptrで呼べば仮想関数経由、final具象readerのポインタで呼べばインライン化される
 template <class P, class T = std::string>
 concept parser = std::predicate<P, reader_ptr &, T &> && std::copy_constructible<P>;
 template <class T = std::string> using parser_t = std::function<bool(reader_ptr &, T &)>;
 
-using match_t = std::bitset<256>;
+using match_t = simd::char_set;
+
+// パーサが最初に読みうる文字の集合
+// nullableならその文字を読まずに成功しうる(入力の終端でも成功しうる)
+struct first_t {
+    match_t match;
+    bool nullable = false;
+};
+
+// 文字の集合に一致する1文字
+// 表はすべて定数式で作るので、組み込みの文法は動的に初期化しない
 class atom {
     match_t match;
+    simd::char_class cls; // many0/many1でまとめて走査するための表
 
-public:
-    atom(char);
-    atom(std::initializer_list<char>);
-    atom(std::string_view);
-    atom(const match_t &_match) : match(_match) {}
-    atom(const atom &) = default;
-    const match_t get_match() const { return match; }
+    template <class R> static constexpr match_t set_of(const R &items) {
+        match_t m;
+        for (const char item : items) {
+            m.set((unsigned char)item);
+        }
+        return m;
+    }
 
-    bool operator()(reader_ptr &, std::string &) const;
+public:
+    constexpr atom(char c) : match(match_t().set((unsigned char)c)), cls(match) {}
+    constexpr atom(std::initializer_list<char> items) : match(set_of(items)), cls(match) {}
+    constexpr atom(std::string_view items) : match(set_of(items)), cls(match) {}
+    constexpr atom(const match_t &_match) : match(_match), cls(_match) {}
+    constexpr atom(const atom &) = default;
+    constexpr const match_t get_match() const { return match; }
+    // 先頭から連続してマッチする文字数
+    size_t span(std::string_view sv) const;
+
+    template <reader_handle Reader, text_sink S> bool operator()(Reader &, S &) const;
 };
 
 // 生成関係
-atom range(unsigned char first, unsigned char last);
-static inline atom one(unsigned char c) { return atom(c); }
-static inline atom list(std::string_view sv) { return atom(sv); }
+static constexpr atom range(unsigned char first, unsigned char last) {
+    assert(first <= last);
+    match_t m;
+    for (size_t i = first; i <= last; i++) {
+        m.set(i);
+    }
+    return m;
+}
+static constexpr atom one(unsigned char c) { return atom(c); }
+static constexpr atom list(std::string_view sv) { return atom(sv); }
 
-inline atom any = range(0, 255);
-inline atom none({});
-atom operator+(const atom &, const atom &);
-atom operator-(const atom &, const atom &);
+static constexpr atom operator+(const atom &x, const atom &y) { return atom(x.get_match() | y.get_match()); }
+static constexpr atom operator-(const atom &x, const atom &y) { return atom(x.get_match() & ~y.get_match()); }
+inline constexpr atom any = range(0, 255);
+inline constexpr atom none({});
+
+// 整数関係
+static constexpr atom digit(unsigned int base = 10) {
+    match_t m;
+    unsigned char i = 0;
+    // 0~9
+    for (; i < base && i < 10; i++) {
+        m.set('0' + i);
+    }
+    // 10~
+    for (; i < base; i++) {
+        m.set('a' + i - 10);
+        m.set('A' + i - 10);
+    }
+    return atom(m);
+}
 
 // 記号
-const inline atom sign = atom("+-");
-const inline atom escape = atom({'\\'});
-const inline atom not_escape = any - escape;
-atom digit(unsigned int n = 10);
-const inline atom small = range('a', 'z');
-const inline atom large = range('A', 'Z');
-const inline atom alpha = small + large;
-const inline atom alnum = small + large + digit();
+inline constexpr atom sign = atom("+-");
+inline constexpr atom escape = atom({'\\'});
+inline constexpr atom not_escape = any - escape;
+inline constexpr atom small = range('a', 'z');
+inline constexpr atom large = range('A', 'Z');
+inline constexpr atom alpha = small + large;
+inline constexpr atom alnum = small + large + digit();
 // 空白
-const inline auto newline = list("\r\n");
-const inline auto space = list(" \t\n\r");
+inline constexpr auto newline = list("\r\n");
+inline constexpr auto space = list(" \t\n\r");
 
+// キーワードは借用するので、文字列リテラルからだけ作れる
 class multi {
-    const std::string keyword;
+    const std::string_view keyword;
 
 public:
-    multi(std::string_view sv) : keyword(sv) {}
-    bool operator()(reader_ptr &, std::string &) const;
+    template <size_t N> constexpr multi(const char (&literal)[N]) : keyword(literal, N - 1) {}
+    constexpr std::string_view get_keyword() const { return keyword; }
+    template <reader_handle Reader, text_sink S> bool operator()(Reader &, S &) const;
 };
 
+// キーワードのトライ(状態×文字クラス→次の状態)で最長一致する
+// 定数式で作れるように表は固定の大きさで持ち、キーワードは借用する(文字列リテラルを想定)
+// 表に収まらなければstd::length_errorを投げる(定数式ならコンパイルエラーになる)
 class multi_list {
-    const std::unordered_map<std::string, bool> table; // true -> tail, false -> continue, null -> mismatch
+public:
+    static constexpr size_t max_keywords = 64, max_states = 128, max_classes = 32;
+
+private:
+    std::array<std::string_view, max_keywords> keywords{};
+    size_t keyword_count = 0;
+    std::array<uint8_t, 256> classes{}; // 文字 -> 文字クラス(0はどのキーワードにも現れない文字)
+    std::array<uint8_t, max_states * max_classes> transitions{}; // state * max_classes + class -> state (0 -> mismatch)
+    std::array<int8_t, max_states> accepts{};                    // state -> keyword index (-1 -> continue)
 
 public:
-    multi_list(const std::vector<std::string> &_keywords);
-    bool operator()(reader_ptr &, std::string &) const;
+    constexpr multi_list(std::span<const std::string_view> _keywords);
+    constexpr multi_list(std::initializer_list<std::string_view> _keywords)
+        : multi_list(std::span(_keywords.begin(), _keywords.size())) {}
+    constexpr std::span<const std::string_view> get_keywords() const { return {keywords.data(), keyword_count}; }
+
+    // 一致したキーワードの番号を返す(失敗したら-1で、位置は戻す)
+    template <reader_handle Reader, text_sink S> int match(Reader &, S &) const;
+    template <reader_handle Reader, text_sink S> bool operator()(Reader &reader, S &s) const {
+        return match(reader, s) >= 0;
+    }
 };
 
 template <parser R, parser L> class chain {
@@ -80,110 +174,256 @@ template <parser R, parser L> class chain {
     const L left;
 
 public:
-    chain(const R &_right, const L &_left) : right(_right), left(_left) {}
-    bool operator()(reader_ptr &, std::string &) const;
+    constexpr chain(const R &_right, const L &_left) : right(_right), left(_left) {}
+    constexpr const R &get_right() const { return right; }
+    constexpr const L &get_left() const { return left; }
+    template <reader_handle Reader, text_sink S> bool operator()(Reader &, S &) const;
 };
-template <parser R, parser L> static inline auto operator*(const R &r, const L &l) { return chain(r, l); }
+template <parser R, parser L> static constexpr auto operator*(const R &r, const L &l) { return chain(r, l); }
 
 template <parser T> class repeat_range {
     const T parser;
     const unsigned int min, max;
 
 public:
-    repeat_range(const T &_parser, unsigned int _min = 0, unsigned int _max = UINT_MAX);
-    bool operator()(reader_ptr &, std::string &) const;
+    constexpr repeat_range(const T &_parser, unsigned int _min = 0, unsigned int _max = UINT_MAX);
+    constexpr const T &get_parser() const { return parser; }
+    constexpr unsigned int get_min() const { return min; }
+    constexpr unsigned int get_max() const { return max; }
+    template <reader_handle Reader, text_sink S> bool operator()(Reader &, S &) const;
 };
 
-template <parser T> static inline auto many0(const T &parser) { return repeat_range(parser, 0); }
-template <parser T> static inline auto many1(const T &parser) { return repeat_range(parser, 1); }
-template <parser T> static inline auto option(const T &parser) { return repeat_range(parser, 0, 1); }
-template <parser T> static inline auto repeat(const T &parser, unsigned int n) { return repeat_range(parser, n, n); }
+template <parser T> static constexpr auto many0(const T &parser) { return repeat_range(parser, 0); }
+template <parser T> static constexpr auto many1(const T &parser) { return repeat_range(parser, 1); }
+template <parser T> static constexpr auto option(const T &parser) { return repeat_range(parser, 0, 1); }
+template <parser T> static constexpr auto repeat(const T &parser, unsigned int n) { return repeat_range(parser, n, n); }
 
 template <class P> class attempt {
     const P parser;
 
 public:
-    attempt(const P &_parser) : parser(_parser) {}
-    template <class T> bool operator()(reader_ptr &reader, T &out) const;
+    constexpr attempt(const P &_parser) : parser(_parser) {}
+    constexpr const P &get_parser() const { return parser; }
+    template <reader_handle Reader, class T> bool operator()(Reader &reader, T &out) const;
 };
 
 template <parser R, parser L> class sum {
     const R right;
     const L left;
+    const first_t right_first, left_first; // 読めない文字で始まる側は試さない
 
 public:
-    sum(const R &_right, const L &_left) : right(_right), left(_left) {}
-    bool operator()(reader_ptr &, std::string &) const;
+    constexpr sum(const R &_right, const L &_left);
+    constexpr const R &get_right() const { return right; }
+    constexpr const L &get_left() const { return left; }
+    template <reader_handle Reader, text_sink S> bool operator()(Reader &, S &) const;
 };
 
-template <parser R, parser L> static inline auto operator+(const R &r, const L &l) { return sum<R, L>(r, l); }
+template <parser R, parser L> static constexpr auto operator+(const R &r, const L &l) { return sum<R, L>(r, l); }
+
+// 型消去する前に先頭文字集合を求めておく
+template <class T> struct alternative {
+    parser_t<T> parser;
+    first_t first;
+
+    template <class P> alternative(const P &_parser);
+};
 
 template <class T> class sigma {
-    const std::vector<parser_t<T>> parsers;
+    const std::vector<alternative<T>> parsers;
+    // 先頭の文字(256は終端)ごとに試す選択肢の集合
+    // 65番目以降の選択肢は常に試す
+    std::array<uint64_t, 257> dispatch;
+
+    void build();
 
 public:
-    sigma(const std::vector<parser_t<T>> &_parsers) : parsers(_parsers) {}
-    sigma(std::initializer_list<parser_t<T>> _parsers) : parsers(_parsers) {}
+    sigma(const std::vector<alternative<T>> &_parsers) : parsers(_parsers) { build(); }
+    sigma(std::initializer_list<alternative<T>> _parsers) : parsers(_parsers) { build(); }
+    const std::vector<alternative<T>> &get_parsers() const { return parsers; }
     bool operator()(reader_ptr &, T &) const;
 };
 
+// 型消去しないsigma(文法が静的に決まるときは全体が一つのオブジェクトとしてインライン化される)
+template <class... Ps> class static_sigma {
+    static_assert(sizeof...(Ps) <= 64);
+    const std::tuple<Ps...> parsers;
+    std::array<uint64_t, 257> dispatch{}; // sigmaと同じ先頭文字ごとの選択肢の集合
+
+    template <size_t I, reader_handle Reader, class T>
+    bool attempt_at(Reader &reader, T &out, uint64_t mask, size_t keep, bool &matched) const;
+
+public:
+    constexpr static_sigma(const Ps &..._parsers);
+    constexpr const std::tuple<Ps...> &get_parsers() const { return parsers; }
+    template <reader_handle Reader, class T> bool operator()(Reader &, T &) const;
+};
+
+// 結果をreaderのmemo_tableに(id, 開始位置)で記録し、同じ位置で試し直すときは読まずに再現する
+// 表が付いていなければそのまま呼ぶ
+// 複製したmemoは同じidを持つので、文法の中で共有すれば別の選択肢からの再走査も省ける
+// memoごとに一意な番号
+// 組み込みの文法は定数式で作るため[0, reserved_memo_ids)の固定の番号を使い、make_memo_idはその後から振る
+inline constexpr uint32_t reserved_memo_ids = 32;
+uint32_t make_memo_id();
+template <class P> class memo {
+    const P parser;
+    const uint32_t id;
+
+public:
+    memo(const P &_parser);
+    constexpr memo(const P &_parser, uint32_t _id) : parser(_parser), id(_id) { assert(id < reserved_memo_ids); }
+    constexpr const P &get_parser() const { return parser; }
+    constexpr uint32_t get_id() const { return id; }
+    template <reader_handle Reader, text_sink S> bool operator()(Reader &, S &) const;
+};
+
+// 名前を付けたパーサ(profile::enabledのときだけnamedが作る)
+// 呼び出し、成否、読んだバイト数、時間と、中のattemptが読み戻したバイト数をprofile::counter_of<Name>に数える
+template <profile::name_t Name, class P> class probe {
+    const P parser;
+
+public:
+    constexpr probe(const P &_parser) : parser(_parser) {}
+    constexpr const P &get_parser() const { return parser; }
+    static constexpr std::string_view get_name() { return Name.view(); }
+    template <reader_handle Reader, class T> bool operator()(Reader &, T &) const;
+};
+
+// プロファイルで数える名前を付ける(数えないビルドではpをそのまま返す)
+template <profile::name_t Name, class P> constexpr auto named(const P &p) {
+    if constexpr (profile::enabled) {
+        return probe<Name, P>(p);
+    } else {
+        return p;
+    }
+}
+
+// innerが1文字ずつ読み、endが始まりえない文字の並び(コメントや文字列の本体)はまとめて読み飛ばす
 template <parser B, parser I, parser E> class bracket {
     const B begin;
     const I inner;
     const E end;
+    simd::char_class skip; // まとめて読み飛ばせる文字(表せなければvalidがfalse)
+
+    static constexpr simd::char_class skippable(const I &inner, const E &end);
 
 public:
-    bracket(const B &_begin, const I &_inner, const E &_end) : begin(_begin), inner(_inner), end(_end) {}
-    bool operator()(reader_ptr &, std::string &) const;
+    constexpr bracket(const B &_begin, const I &_inner, const E &_end)
+        : begin(_begin), inner(_inner), end(_end), skip(skippable(_inner, _end)) {}
+    constexpr const B &get_begin() const { return begin; }
+    constexpr const I &get_inner() const { return inner; }
+    constexpr const E &get_end() const { return end; }
+    template <reader_handle Reader, text_sink S> bool operator()(Reader &, S &) const;
 };
 
+// 先頭文字集合
+// 分からないパーサは任意の文字から始まり、空でも成功しうるものとして扱う
+template <class P> constexpr first_t first_of(const P &) { return first_t{~match_t(), true}; }
+constexpr first_t first_of(const atom &a) { return first_t{a.get_match(), false}; }
+constexpr first_t first_of(const multi &m) {
+    if (m.get_keyword().empty()) {
+        return first_t{match_t(), true};
+    }
+    return first_t{one(m.get_keyword()[0]).get_match(), false};
+}
+constexpr first_t first_of(const multi_list &m) {
+    first_t f;
+    for (const std::string_view keyword : m.get_keywords()) {
+        if (keyword.empty()) {
+            f.nullable = true;
+        } else {
+            f.match.set((unsigned char)keyword[0]);
+        }
+    }
+    return f;
+}
+template <class R, class L> constexpr first_t first_of(const chain<R, L> &);
+template <class T> constexpr first_t first_of(const repeat_range<T> &);
+template <class P> constexpr first_t first_of(const attempt<P> &);
+template <class R, class L> constexpr first_t first_of(const sum<R, L> &);
+template <class T> first_t first_of(const sigma<T> &);
+template <class... Ps> constexpr first_t first_of(const static_sigma<Ps...> &);
+template <class P> constexpr first_t first_of(const memo<P> &);
+template <profile::name_t Name, class P> constexpr first_t first_of(const probe<Name, P> &);
+template <class B, class I, class E> constexpr first_t first_of(const bracket<B, I, E> &);
+
+// 特殊
+struct eof_t {
+    template <reader_handle Reader, class T> bool operator()(Reader &reader, T &) const { return !reader->peek(); }
+};
+inline constexpr eof_t eof;
+constexpr first_t first_of(const eof_t &) { return first_t{match_t(), true}; }
+
+// その文字をちょうど1文字だけ読んで成功すると分かる文字の集合
+template <class P> constexpr match_t single_of(const P &) { return match_t(); }
+constexpr match_t single_of(const atom &a) { return a.get_match(); }
+template <class R, class L> constexpr match_t single_of(const sum<R, L> &);
+
+// 入力の終端より前で、何も読まずに失敗するとは限らない文字の集合(分からなければnullopt)
+template <class P> constexpr std::optional<match_t> stops_of(const P &p) {
+    const first_t f = first_of(p);
+    return f.nullable ? std::nullopt : std::optional(f.match);
+}
+constexpr std::optional<match_t> stops_of(const eof_t &) { return match_t(); }
+template <class R, class L> constexpr std::optional<match_t> stops_of(const sum<R, L> &);
+
+} // namespace tokenize::parsers
+
+#include "parsers.cxx"
+
+// 組み込みの文法
+// 定数式で組み立てて静的に初期化するので、テンプレートの定義(parsers.cxx)より後に置く
+namespace tokenize::parsers {
+
 // token series
 
 // 整数関係
 
-static inline auto escaped_digits(unsigned int n = 10) {
+static constexpr auto escaped_digits(unsigned int n = 10) {
     return many1(digit(n)) * many0(attempt(many1(one('_')) * many1(digit(n))));
 }
 
 // アルファベット
 
-const inline auto escaped_char = not_escape + one('\\') * any;
+inline constexpr auto escaped_char = not_escape + one('\\') * any;
 
-const inline auto spaces = many1(space);
+inline constexpr auto spaces = named<"spaces">(many1(space));
 
-// 特殊
-struct eof_t {
-    template <class T> bool operator()(reader_ptr &reader, T &) const { return !reader->peek(); }
-};
-static const inline eof_t eof;
+// realとintegerは同じ位置の数字列を読み直すので共有する(番号は基数)
+// プロファイルはmemoで省けなかった呼び出しだけを数える
+inline constexpr auto digits2 = memo(named<"digits2">(escaped_digits(2)), 2);
+inline constexpr auto digits4 = memo(named<"digits4">(escaped_digits(4)), 4);
+inline constexpr auto digits8 = memo(named<"digits8">(escaped_digits(8)), 8);
+inline constexpr auto digits10 = memo(named<"digits10">(escaped_digits(10)), 10);
+inline constexpr auto digits16 = memo(named<"digits16">(escaped_digits(16)), 16);
 
 // integer
-const inline auto integer =
-    option(sign) * (attempt(multi("0b") * escaped_digits(2)) + attempt(multi("0q") * escaped_digits(4)) +
-                    attempt(multi("0o") * escaped_digits(8)) + attempt(multi("0d") * escaped_digits(10)) +
-                    attempt(multi("0x") * escaped_digits(16)) + escaped_digits(10));
+inline constexpr auto integer = named<"integer">(
+    option(sign) * (attempt(multi("0b") * digits2) + attempt(multi("0q") * digits4) + attempt(multi("0o") * digits8) +
+                    attempt(multi("0d") * digits10) + attempt(multi("0x") * digits16) + digits10));
 
 // real
-const inline auto dot = one('.');
-const inline auto mantissa_digits(unsigned int n) { return escaped_digits(n) * dot * escaped_digits(n); }
-const inline auto mantissa =
-    option(sign) * (attempt(multi("0b") * mantissa_digits(2)) + attempt(multi("0q") * mantissa_digits(4)) +
-                    attempt(multi("0o") * mantissa_digits(8)) + attempt(multi("0d") * mantissa_digits(10)) +
-                    attempt(multi("0x") * mantissa_digits(16)) + mantissa_digits(10));
-const inline auto exponent = list("eE") * option(sign) * escaped_digits(10);
-const inline auto real = mantissa * option(exponent);
+inline constexpr auto dot = one('.');
+template <class P> static constexpr auto mantissa_digits(const P &digits) { return digits * dot * digits; }
+inline constexpr auto mantissa = named<"mantissa">(
+    option(sign) * (attempt(multi("0b") * mantissa_digits(digits2)) + attempt(multi("0q") * mantissa_digits(digits4)) +
+                    attempt(multi("0o") * mantissa_digits(digits8)) + attempt(multi("0d") * mantissa_digits(digits10)) +
+                    attempt(multi("0x") * mantissa_digits(digits16)) + mantissa_digits(digits10)));
+inline constexpr auto exponent = named<"exponent">(list("eE") * option(sign) * escaped_digits(10));
+inline constexpr auto real = named<"real">(mantissa * option(exponent));
 
 // boolean
-const inline auto boolean = multi_list({"true", "false"});
+inline constexpr auto boolean = named<"boolean">(multi_list({"true", "false"}));
 
 // atoms(others)
-const inline auto text = attempt(bracket(multi("\"\"\""), escaped_char, attempt(multi("\"\"\"")))) +
-                         bracket(one('"'), escaped_char, one('"'));
-
-const inline auto comment =
-    attempt(bracket(multi("//"), any, newline + eof)) + bracket(multi("/*"), any, attempt(multi("*/")));
-const inline auto variable = (alpha + one('_')) * many0(alnum + one('_'));
-const inline auto character = one('\'') * escaped_char * one('\'');
+inline constexpr auto text =
+    named<"text">(attempt(bracket(multi("\"\"\""), escaped_char, attempt(multi("\"\"\"")))) +
+                  bracket(one('"'), escaped_char, one('"')));
+
+inline constexpr auto comment = named<"comment">(attempt(bracket(multi("//"), any, newline + eof)) +
+                                                bracket(multi("/*"), any, attempt(multi("*/"))));
+inline constexpr auto variable = named<"variable">((alpha + one('_')) * many0(alnum + one('_')));
+inline constexpr auto character = named<"character">(one('\'') * escaped_char * one('\''));
 } // namespace tokenize::parsers
 
-#include "parsers.cxx"
@@ -1,9 +1,11 @@
 #include "acutest.h"
 #include "parsers.hpp"
 #include "readers.hpp"
+#include <sstream>
 
 using namespace tokenize::parsers;
-using tokenize::readers::make_string_reader;
+using tokenize::readers::make_string_reader, tokenize::readers::reader_ptr;
+using tokenize::readers::view_reader, tokenize::readers::stream_reader;
 
 // digit
 void digit_success_1_test() {
@@ -12,6 +14,46 @@ void digit_success_1_test() {
     TEST_ASSERT(digit()(reader, s));
 }
 
+// atom span
+void atom_span_test() {
+    // every class, including ones that do not fit in nibble tables
+    const atom classes[] = {alnum + one('_'), space, digit(16), any, none, list("!#%&aAzZ09\x80\xff"),
+                            atom(match_t(0x5555555555555555ull) << 64 | match_t(0x123456789abcdefull))};
+    std::string body;
+    for (int i = 0; i < 300; i++) {
+        body.push_back(char(i * 37 + 11));
+    }
+    for (const auto &a : classes) {
+        for (size_t begin = 0; begin < body.size(); begin++) {
+            size_t expect = 0;
+            for (; begin + expect < body.size() && a.get_match().test((unsigned char)body[begin + expect]); expect++) {
+            }
+            TEST_ASSERT(a.span(std::string_view(body).substr(begin)) == expect);
+        }
+    }
+}
+
+void many_atom_long_test() {
+    const std::string body = std::string(100, 'a') + "_9 rest";
+    auto reader = make_string_reader(body);
+    std::string s;
+    TEST_ASSERT(many1(alnum + one('_'))(reader, s) && s == std::string(100, 'a') + "_9");
+    TEST_ASSERT(reader->get_offset() == 102);
+
+    // max
+    reader->set_offset(0), s.clear();
+    TEST_ASSERT(repeat(one('a'), 40)(reader, s) && s == std::string(40, 'a'));
+}
+
+void many_atom_stream_test() {
+    std::istringstream source(std::string(37, 'x') + "!");
+    stream_reader r(source, 3);
+    stream_reader *reader = &r;
+    std::string s;
+    TEST_ASSERT(many1(alpha)(reader, s) && s == std::string(37, 'x'));
+    TEST_ASSERT(reader->peek() == '!');
+}
+
 // multi
 void multi_success_test() {
     auto reader = make_string_reader("hello");
@@ -38,6 +80,24 @@ void multi_failed_1_test() {
     TEST_ASSERT(reader->get_position() != p);
 }
 
+// the keyword table has a fixed size
+void multi_list_limits_test() {
+    std::vector<std::string> storage;
+    for (size_t i = 0; i <= multi_list::max_keywords; i++) {
+        storage.push_back("k" + std::to_string(i));
+    }
+    const std::vector<std::string_view> keywords(storage.begin(), storage.end());
+    const std::span<const std::string_view> all(keywords);
+    TEST_CHECK(multi_list(all.first(multi_list::max_keywords)).get_keywords().size() == multi_list::max_keywords);
+    TEST_EXCEPTION(multi_list{all}, std::length_error);
+
+    // too many distinct characters
+    TEST_EXCEPTION(multi_list({"abcdefghijklmnop", "qrstuvwxyzABCDEFG"}), std::length_error);
+    // too many trie states
+    const std::string long_keyword(multi_list::max_states, 'a');
+    TEST_EXCEPTION(multi_list({std::string_view(long_keyword)}), std::length_error);
+}
+
 // multi_list
 void multi_list_success_0_test() {
     auto parser = multi_list({"hello", "hola"});
@@ -67,6 +127,30 @@ void multi_list_failed_0_test() {
     }
 }
 
+void multi_list_longest_test() {
+    auto parser = multi_list({"<", "<<", "<<=", "<=", "ab", "abcd"});
+    const std::pair<const char *, const char *> cases[] = {
+        {"<", "<"}, {"<<", "<<"}, {"<<=", "<<="}, {"<<<", "<<"}, {"<=<", "<="}, {"abc", "ab"}, {"abcd", "abcd"}};
+    for (const auto &[input, expect] : cases) {
+        auto reader = make_string_reader(input);
+        std::string s;
+        TEST_ASSERT(parser(reader, s) && s == expect);
+        TEST_ASSERT(reader->get_offset() == s.size());
+    }
+}
+
+void multi_list_index_test() {
+    auto parser = multi_list({"int", "uint", "in"});
+    auto reader = make_string_reader("uintx");
+    std::string s = "pre";
+    TEST_ASSERT(parser.match(reader, s) == 1 && s == "preuint");
+
+    // mismatch restores the position
+    reader = make_string_reader("ui");
+    s.clear();
+    TEST_ASSERT(parser.match(reader, s) == -1 && s.empty() && reader->get_offset() == 0);
+}
+
 // commnet
 void commnet_success_line_test() {
     auto reader = make_string_reader("//ab\n");
@@ -84,6 +168,28 @@ void commnet_success_block_test() {
     }
 }
 
+// bracket body skipping
+void bracket_skip_test() {
+    const std::string body(100, 'x');
+    const std::string block = "/*" + body + "* / **" + body + "**/";
+    const std::string line = "//" + body + "\r";
+    const std::string quoted = "\"" + body + "\\\"" + body + "\\\\\"";
+    for (const size_t chunk : {size_t(1), size_t(3), size_t(64)}) {
+        std::istringstream source(block + line + quoted + "\"" + body);
+        stream_reader r(source, chunk);
+        stream_reader *reader = &r;
+        std::string s;
+        TEST_ASSERT(comment(reader, s) && s == block);
+        s.clear();
+        TEST_ASSERT(comment(reader, s) && s == line);
+        s.clear();
+        TEST_ASSERT(text(reader, s) && s == quoted);
+        // unterminated string reads to the end and fails
+        s.clear();
+        TEST_ASSERT(!text(reader, s) && s == "\"" + body && !reader->peek());
+    }
+}
+
 // variable
 void variable_success_alpha_test() {
     auto reader = make_string_reader("hello");
@@ -142,19 +248,213 @@ void character_failed_over_test() {
     }
 }
 
+// span
+void span_sink_test() {
+    const std::string src = "  /* c */ 0x1F_FF;";
+    auto reader = make_string_reader(src);
+    span gap{reader->get_offset()};
+    TEST_ASSERT(many0(spaces + comment)(reader, gap) && gap.view(src) == "  /* c */ ");
+
+    span number{reader->get_offset()};
+    TEST_ASSERT(!attempt(real)(reader, number) && number.length == 0);
+    TEST_ASSERT(attempt(integer)(reader, number) && number.view(src) == "0x1F_FF");
+}
+
+// first set
+void first_of_grammar_test() {
+    const first_t i = first_of(integer);
+    TEST_ASSERT(!i.nullable && i.match == (sign + digit()).get_match());
+    const first_t c = first_of(comment);
+    TEST_ASSERT(!c.nullable && c.match == one('/').get_match());
+    const first_t v = first_of(variable);
+    TEST_ASSERT(!v.nullable && v.match == (alpha + one('_')).get_match());
+    TEST_ASSERT(first_of(many0(spaces + comment)).nullable);
+    TEST_ASSERT(first_of(boolean).match == list("tf").get_match());
+}
+
+// 組み込みの文法は定数式で作られる
+void constexpr_grammar_test() {
+    static_assert(digit(16).get_match().test('F') && !digit(16).get_match().test('g'));
+    static_assert((any - escape).get_match().count() == 255);
+    static_assert(first_of(integer).match == (sign + digit()).get_match());
+    constexpr multi_list keywords{"<", "<<", "<<="};
+    static_assert(keywords.get_keywords().size() == 3 && first_of(keywords).match == one('<').get_match());
+    static_assert(digits10.get_id() < reserved_memo_ids);
+    // 数えないビルドでは名前を付けても型は変わらない
+    static_assert(tokenize::profile::enabled || std::is_same_v<decltype(named<"x">(one('a'))), atom>);
+
+    // 定数のトライでも実行時に作ったものと同じく最長一致する
+    auto reader = make_string_reader("<<<=");
+    std::string s;
+    TEST_ASSERT(keywords.match(reader, s) == 1 && s == "<<");
+    TEST_ASSERT(keywords.match(reader, s) == 0 && s == "<<<" && reader->get_offset() == 3);
+}
+
+void sigma_dispatch_test() {
+    int calls = 0;
+    const auto counted = [&calls](reader_ptr &, std::string &) { return calls++, false; };
+    const sigma<std::string> parsers{alternative<std::string>(variable), alternative<std::string>(integer),
+                                     parser_t<std::string>(counted)};
+    auto reader = make_string_reader("12");
+    std::string s;
+    TEST_ASSERT(parsers(reader, s) && s == "12");
+    // erased parsers are always tried
+    reader = make_string_reader("!");
+    TEST_ASSERT(!parsers(reader, s) && calls == 1);
+}
+
+void static_sigma_test() {
+    const static_sigma parsers{attempt(integer), variable, attempt(multi("!="))};
+    std::string s;
+    auto reader = make_string_reader("abc");
+    TEST_ASSERT(parsers(reader, s) && s == "abc");
+    reader = make_string_reader("-12"), s.clear();
+    TEST_ASSERT(parsers(reader, s) && s == "-12");
+    reader = make_string_reader("!="), s.clear();
+    TEST_ASSERT(parsers(reader, s) && s == "!=");
+    reader = make_string_reader("!!"), s.clear();
+    TEST_ASSERT(!parsers(reader, s) && reader->get_offset() == 0);
+    const first_t f = first_of(parsers);
+    TEST_ASSERT(!f.nullable && f.match == (sign + digit() + alpha + one('_') + one('!')).get_match());
+}
+
+// concrete reader
+void concrete_reader_integer_test() {
+    view_reader source("0x1F_FF+1");
+    view_reader *reader = &source;
+    std::string s;
+    TEST_ASSERT(integer(reader, s) && s == "0x1F_FF");
+    TEST_ASSERT(reader->peek() == '+');
+}
+
+void concrete_reader_comment_test() {
+    view_reader source("/*a*/b");
+    view_reader *reader = &source;
+    std::string s;
+    TEST_ASSERT(comment(reader, s) && s == "/*a*/");
+    TEST_ASSERT(variable(reader, s) && s == "/*a*/b");
+}
+
+// memo
+void memo_test() {
+    const auto digits = memo(escaped_digits(10));
+    const auto twice = attempt(digits * one('.')) + digits; // the second try is replayed
+    view_reader source("12_34;");
+    view_reader *reader = &source;
+    tokenize::readers::memo_table table;
+    source.set_memo(&table);
+
+    std::string s;
+    TEST_ASSERT(twice(reader, s) && s == "12_34");
+    TEST_ASSERT(reader->peek() == ';');
+    TEST_CHECK(table.size() == 1);
+    const auto *e = table.find(digits.get_id(), 0);
+    TEST_ASSERT(e && e->result && e->end == 5);
+
+    // failure is recorded with its end offset
+    source.set_offset(5);
+    TEST_ASSERT(!digits(reader, s));
+    TEST_ASSERT(!digits(reader, s) && reader->get_offset() == 5);
+    TEST_CHECK(table.size() == 2);
+
+    // colliding entries are overwritten
+    tokenize::readers::memo_table small(16);
+    for (size_t i = 0; i < 100; i++) {
+        small.insert(1, i, i + 1, true);
+    }
+    TEST_CHECK(small.size() == 16 && small.find(1, 99)->end == 100 && !small.find(1, 0));
+    table.clear();
+    TEST_CHECK(table.size() == 0 && !table.find(1, 0));
+}
+
+void memo_stream_test() {
+    // replayed across chunks
+    std::istringstream input("1234_5678+");
+    stream_reader r(input, 2);
+    stream_reader *reader = &r;
+    tokenize::readers::memo_table table;
+    r.set_memo(&table);
+    std::string s;
+    TEST_ASSERT(!attempt(digits10 * one('.'))(reader, s) && s.empty());
+    TEST_ASSERT(digits10(reader, s) && s == "1234_5678" && reader->peek() == '+');
+}
+
+// diagnostics
+void diagnostics_test() {
+    using tokenize::readers::diagnostic_sink;
+    diagnostic_sink sink(diagnostic_sink::records, 2);
+    std::string s;
+    {
+        view_reader r("ac");
+        view_reader *reader = &r;
+        r.set_diagnostics(&sink);
+        TEST_ASSERT(!(multi("ab") + one('a'))(reader, s));
+    }
+    {
+        view_reader r("aba");
+        view_reader *reader = &r;
+        r.set_diagnostics(&sink);
+        TEST_ASSERT(many0(multi("ab"))(reader, s));
+        r.set_offset(0);
+        TEST_ASSERT(many0(multi("ab"))(reader, s)); // 容量を超えた分は数えるだけ
+    }
+    TEST_ASSERT(sink.get_records().size() == 2);
+    const diagnostic &d = sink.get_records()[0], &e = sink.get_records()[1];
+    TEST_CHECK(d.kind == diagnostic::overrun && d.combinator == diagnostic::sum && d.offset == 0 && d.end == 1);
+    TEST_CHECK(e.kind == diagnostic::overrun_repeat_max && e.offset == 2 && e.end == 3);
+    TEST_CHECK(sink.count(diagnostic::overrun_repeat_max) == 2 && sink.total() == 3 && sink.get_dropped() == 1);
+    std::ostringstream os;
+    sink.format(os);
+    TEST_CHECK(os.str() == "overrun\noverrun (repeat max)\n(1 more)\n");
+
+    // 数えるだけなら記録しない
+    diagnostic_sink counters(diagnostic_sink::counters);
+    view_reader r("ac");
+    view_reader *reader = &r;
+    r.set_diagnostics(&counters);
+    TEST_ASSERT(!(multi("ab") + one('a'))(reader, s));
+    TEST_CHECK(counters.count(diagnostic::overrun) == 1 && counters.get_records().empty());
+    counters.clear();
+    TEST_CHECK(counters.total() == 0);
+}
+
+// stream reader
+void stream_reader_real_test() {
+    std::istringstream source("0x12_34.5 123");
+    stream_reader r(source, 2);
+    stream_reader *reader = &r;
+    std::string s;
+    // real tries prefixed alternatives and rewinds across chunks
+    TEST_ASSERT(real(reader, s) && s == "0x12_34.5");
+    s.clear();
+    TEST_ASSERT(spaces(reader, s));
+    s.clear();
+    TEST_ASSERT(!attempt(real)(reader, s) && reader->get_position().offset == 10);
+    s.clear();
+    TEST_ASSERT(integer(reader, s) && s == "123");
+}
+
 TEST_LIST = {
     // digit
     {"digit_success_1_test",digit_success_1_test},
+    // atom span
+    {"atom_span_test", atom_span_test},
+    {"many_atom_long_test", many_atom_long_test},
+    {"many_atom_stream_test", many_atom_stream_test},
     // multi
     {"multi_success_test", multi_success_test},
     {"multi_faield_0_test", multi_failed_0_test},
     {"multi_faield_1_test", multi_failed_1_test},
     // multi list
+    {"multi_list_limits_test", multi_list_limits_test},
     {"multi_list_success_0_test", multi_list_success_0_test},
     {"multi_list_failed_0_test", multi_list_failed_0_test},
+    {"multi_list_longest_test", multi_list_longest_test},
+    {"multi_list_index_test", multi_list_index_test},
     // comment
     {"commnet_success_line_test", commnet_success_line_test},
     {"commnet_success_block_test", commnet_success_block_test},
+    {"bracket_skip_test", bracket_skip_test},
     // variable
     {"variable_success_alpha_test", variable_success_alpha_test},
     {"variable_success_alnum_test", variable_success_alnum_test},
@@ -164,5 +464,22 @@ TEST_LIST = {
     {"character_success_newline_test", character_success_newline_test},
     {"character_failed_empty_test", character_failed_empty_test},
     {"character_failed_over_test", character_failed_over_test},
+    // span
+    {"span_sink_test", span_sink_test},
+    // first set
+    {"first_of_grammar_test", first_of_grammar_test},
+    {"constexpr_grammar_test", constexpr_grammar_test},
+    {"sigma_dispatch_test", sigma_dispatch_test},
+    {"static_sigma_test", static_sigma_test},
+    // concrete reader
+    {"concrete_reader_integer_test", concrete_reader_integer_test},
+    {"concrete_reader_comment_test", concrete_reader_comment_test},
+    // memo
+    {"memo_test", memo_test},
+    {"memo_stream_test", memo_stream_test},
+    // diagnostics
+    {"diagnostics_test", diagnostics_test},
+    // stream reader
+    {"stream_reader_real_test", stream_reader_real_test},
     // end
     {nullptr, nullptr}};
\ No newline at end of file
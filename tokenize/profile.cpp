@@ -0,0 +1,37 @@
+#include "profile.hpp"
+#if TOKENIZE_PROFILE
+#include <iomanip>
+#include <tuple>
+namespace tokenize::profile {
+
+std::vector<entry> snapshot() {
+    std::vector<entry> es;
+    for (counter *c = enrolled_head.load(); c != nullptr; c = c->next) {
+        es.push_back(entry{c->name, c->calls, c->successes, c->failures, c->consumed, c->rewound, c->cycles});
+    }
+    std::stable_sort(es.begin(), es.end(), [](const entry &x, const entry &y) {
+        return std::tie(x.rewound, x.cycles) > std::tie(y.rewound, y.cycles);
+    });
+    return es;
+}
+
+void reset() {
+    for (counter *c = enrolled_head.load(); c != nullptr; c = c->next) {
+        c->calls = 0, c->successes = 0, c->failures = 0;
+        c->consumed = 0, c->rewound = 0, c->cycles = 0;
+    }
+}
+
+void report(std::ostream &os) {
+    os << std::left << std::setw(16) << "name" << std::right << std::setw(12) << "rewound" << std::setw(12) << "calls"
+       << std::setw(12) << "successes" << std::setw(12) << "failures" << std::setw(12) << "consumed" << std::setw(16)
+       << "cycles" << std::setw(12) << "cycles/call" << std::endl;
+    for (const entry &e : snapshot()) {
+        os << std::left << std::setw(16) << e.name << std::right << std::setw(12) << e.rewound << std::setw(12)
+           << e.calls << std::setw(12) << e.successes << std::setw(12) << e.failures << std::setw(12) << e.consumed
+           << std::setw(16) << e.cycles << std::setw(12) << (e.calls ? e.cycles / e.calls : 0) << std::endl;
+    }
+}
+
+} // namespace tokenize::profile
+#endif
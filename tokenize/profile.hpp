@@ -0,0 +1,101 @@
+#pragma once
+#include <algorithm>
+#include <stddef.h>
+#include <string_view>
+
+// TOKENIZE_PROFILE=1でビルドすると、名前を付けたパーサ(parsers::named)の呼び出しを数える
+// 0(既定)ならnamedは元のパーサをそのまま返し、attemptも何も数えないので実行時の負担はない
+// 計数と計時の宣言も1のときだけあり、0ではnamedに使う名前の型だけになる
+#ifndef TOKENIZE_PROFILE
+#define TOKENIZE_PROFILE 0
+#endif
+#if TOKENIZE_PROFILE
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <stdint.h>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+namespace tokenize::profile {
+
+inline constexpr bool enabled = TOKENIZE_PROFILE;
+
+// テンプレート引数に渡せる名前
+template <size_t N> struct name_t {
+    char data[N];
+
+    constexpr name_t(const char (&s)[N]) { std::copy(s, s + N, data); }
+    constexpr std::string_view view() const { return {data, N - 1}; }
+};
+
+#if TOKENIZE_PROFILE
+
+// 名前ごとの計数
+// 数えるときはロックしない(複数スレッドで数えると取りこぼすことがある)
+struct counter {
+    const std::string_view name;
+    std::atomic<uint64_t> calls = 0, successes = 0, failures = 0;
+    std::atomic<uint64_t> consumed = 0; // 成功して読んだバイト数
+    std::atomic<uint64_t> rewound = 0;  // 中のattemptが失敗して読み戻したバイト数(無駄になった先読み)
+    std::atomic<uint64_t> cycles = 0;   // 中のパーサを含めた時間
+    std::atomic<bool> enrolled = false;
+    counter *next = nullptr;
+
+    constexpr counter(std::string_view _name) : name(_name) {}
+};
+
+// 名前ごとに一つ(定数で初期化される)
+template <name_t Name> inline counter counter_of{Name.view()};
+
+// 一度でも呼ばれた計数の連結リスト
+inline std::atomic<counter *> enrolled_head = nullptr;
+// 実行中の一番内側の名前付きパーサ(なければroot)
+inline counter root{"(root)"};
+inline thread_local counter *current = &root;
+
+inline void add(std::atomic<uint64_t> &a, uint64_t n) {
+    a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+inline void enroll(counter &c) {
+    if (c.enrolled.load(std::memory_order_relaxed) || c.enrolled.exchange(true)) {
+        return;
+    }
+    c.next = enrolled_head.load();
+    while (!enrolled_head.compare_exchange_weak(c.next, &c)) {
+    }
+}
+
+// 計時(x86ではTSCのカウント、それ以外はナノ秒)
+inline uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+}
+
+// attemptが読み戻したバイト数を、実行中の名前付きパーサに付ける
+inline void rewind(size_t n) {
+    enroll(*current);
+    add(current->rewound, n);
+}
+
+struct entry {
+    std::string_view name;
+    uint64_t calls, successes, failures, consumed, rewound, cycles;
+};
+
+// 一度でも呼ばれた名前の計数(読み戻したバイト数の多い順)
+std::vector<entry> snapshot();
+// 計数を0に戻す
+void reset();
+// snapshotを表にして書き出す
+void report(std::ostream &);
+#endif
+
+} // namespace tokenize::profile
@@ -0,0 +1,74 @@
+#include "acutest.h"
+#include "parsers.hpp"
+#include "profile.hpp"
+
+using namespace tokenize::parsers;
+using namespace tokenize::profile;
+using tokenize::readers::make_string_reader;
+
+static entry find(std::string_view name) {
+    for (const entry &e : snapshot()) {
+        if (e.name == name) {
+            return e;
+        }
+    }
+    return entry{};
+}
+
+// 名前を付けるとprobeで包む
+void named_test() {
+    static_assert(enabled);
+    constexpr auto p = named<"a">(one('a'));
+    static_assert(std::is_same_v<decltype(p), const probe<"a", atom>>);
+    static_assert(decltype(p)::get_name() == "a" && first_of(p).match == one('a').get_match());
+}
+
+// 呼び出し、成否、読んだバイト数を数える
+void counter_test() {
+    reset();
+    const auto p = many0(named<"ab">(multi("ab")));
+    auto reader = make_string_reader("ababa");
+    std::string s;
+    TEST_ASSERT(p(reader, s) && s == "ababa");
+    const entry e = find("ab");
+    TEST_CHECK(e.calls == 3 && e.successes == 2 && e.failures == 1);
+    TEST_CHECK(e.consumed == 4 && e.rewound == 0);
+}
+
+// attemptが読み戻したバイト数は実行中の一番内側の名前に付ける
+void rewound_test() {
+    reset();
+    const auto pair = named<"pair">(multi("ab") * one('c'));
+    const auto p = named<"outer">(attempt(pair) + multi("abd"));
+    auto reader = make_string_reader("abd");
+    std::string s;
+    TEST_ASSERT(p(reader, s) && s == "abd");
+    const entry outer = find("outer"), inner = find("pair");
+    TEST_CHECK(outer.calls == 1 && outer.successes == 1 && outer.consumed == 3 && outer.rewound == 2);
+    TEST_CHECK(inner.calls == 1 && inner.failures == 1 && inner.rewound == 0);
+    TEST_CHECK(outer.cycles >= inner.cycles);
+
+    // 読み戻したバイト数の多い順に並ぶ
+    TEST_CHECK(snapshot().front().name == "outer");
+    std::ostringstream os;
+    report(os);
+    TEST_CHECK(os.str().find("outer") < os.str().find("pair"));
+}
+
+// 組み込みの文法にも名前が付いている
+void grammar_test() {
+    reset();
+    auto reader = make_string_reader("0x1f");
+    std::string s;
+    TEST_ASSERT(integer(reader, s) && s == "0x1f");
+    TEST_CHECK(find("integer").successes == 1 && find("integer").consumed == 4);
+    TEST_CHECK(find("digits2").calls == 0 && find("digits16").successes == 1);
+}
+
+TEST_LIST = {
+    {"named_test", named_test},
+    {"counter_test", counter_test},
+    {"rewound_test", rewound_test},
+    {"grammar_test", grammar_test},
+    // end
+    {nullptr, nullptr}};
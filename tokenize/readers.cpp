@@ -1,4 +1,11 @@
 #include "readers.hpp"
+#include "simd.hpp"
+#include <algorithm>
+#include <cassert>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace tokenize::readers {
 
@@ -17,36 +24,276 @@ bool position::operator!=(const position &p) const {
     return offset != p.offset || line != p.line || number != p.number;
 }
 
-void position::next(char c) {
-    offset += 1;
-    if (c != '\n' && c != '\r') {
-        line += 0, number += 1;
-    } else {
+void position::next(std::string_view body) {
+    const char *iter = body.data(), *const last = body.data() + body.size();
+    while (true) {
+        const char *const newline = simd::find_either(iter, last, '\n', '\r');
+        number += newline - iter;
+        if (newline == last) {
+            break;
+        }
         line += 1, number = 0;
+        iter = newline + 1;
     }
+    offset += body.size();
 }
 
-string_reader::string_reader(std::string_view _body)
-    : body(_body), begin(body.begin()), iter(body.begin()), end(body.end()) {}
+memo_table::memo_table(size_t capacity) {
+    size_t n = 16;
+    while (n < capacity) {
+        n *= 2;
+    }
+    slots.resize(n);
+}
+
+void memo_table::clear() { std::fill(slots.begin(), slots.end(), entry()); }
+
+size_t memo_table::size() const {
+    return std::count_if(slots.begin(), slots.end(), [](const entry &e) { return e.key != empty; });
+}
+
+diagnostic_sink::diagnostic_sink(mode_t _mode, size_t _capacity) : mode(_mode), capacity(_capacity) {
+    if (mode == records) {
+        recorded.reserve(capacity);
+    }
+}
+
+void diagnostic_sink::clear() {
+    recorded.clear();
+    counts.fill(0);
+    dropped = 0;
+}
+
+uint64_t diagnostic_sink::total() const {
+    uint64_t n = 0;
+    for (const uint64_t c : counts) {
+        n += c;
+    }
+    return n;
+}
+
+std::string_view diagnostic_sink::message(diagnostic::kind_t kind) {
+    switch (kind) {
+    case diagnostic::overrun_repeat_min:
+        return "overrun (repeat min)";
+    case diagnostic::overrun_repeat_max:
+        return "overrun (repeat max)";
+    default:
+        return "overrun";
+    }
+}
+
+void diagnostic_sink::format(std::ostream &os) const {
+    for (const diagnostic &d : recorded) {
+        os << message(d.kind) << std::endl;
+    }
+    if (dropped > 0) {
+        os << "(" << dropped << " more)" << std::endl;
+    }
+}
+
+void line_index::scan(std::string_view body) {
+    const char *const first = body.data(), *const last = body.data() + body.size();
+    for (const char *iter = first; (iter = simd::find_either(iter, last, '\n', '\r')) != last; iter++) {
+        newlines.push_back(scanned + (iter - first));
+    }
+    scanned += body.size();
+}
+
+void line_index::trim(size_t offset) {
+    while (!newlines.empty() && newlines.front() < offset) {
+        last_dropped = newlines.front();
+        newlines.pop_front(), dropped++;
+    }
+}
+
+position line_index::locate(size_t offset) const {
+    assert(offset <= scanned);
+    // offsetより前にある改行の数が行番号になる
+    const size_t k = std::lower_bound(newlines.begin(), newlines.end(), offset) - newlines.begin();
+    const std::optional<size_t> last = k > 0 ? std::optional<size_t>(newlines[k - 1]) : last_dropped;
+    return position(offset, dropped + k, last ? offset - *last - 1 : offset);
+}
+
+view_reader::view_reader(std::string_view _body) { reset(_body); }
+
+void view_reader::reset(std::string_view _body) {
+    begin = _body.data(), end = _body.data() + _body.size(), iter = begin;
+    lines = line_index();
+}
+
+position view_reader::locate(size_t offset) const {
+    // 必要なところまで索引を伸ばす
+    if (const size_t scanned = lines.get_scanned(); scanned < offset) {
+        lines.scan(std::string_view(begin + scanned, offset - scanned));
+    }
+    return lines.locate(offset);
+}
+
+position tracking_reader::locate(size_t offset) const {
+    if (const size_t scanned = lines.get_scanned(); scanned < offset) {
+        lines.scan(std::string_view(begin + scanned, offset - scanned));
+    }
+    return lines.locate(offset);
+}
+
+string_reader::string_reader(std::string_view _body) : view_reader({}), body(_body) { reset(body); }
 
-std::optional<char> string_reader::peek() const {
-    if (iter == end) {
+// 複製先のbodyを指し直す
+string_reader::string_reader(const string_reader &sr) : view_reader(sr), body(sr.body) {
+    reset(body);
+    set_offset(sr.get_offset());
+}
+
+string_reader::string_reader(string_reader &&sr) : view_reader(sr), body(std::move(sr.body)) {
+    reset(body);
+    set_offset(sr.get_offset());
+}
+
+mmap_reader::mmap_reader(const char *_begin, const char *_end) : view_reader(std::string_view(_begin, _end - _begin)) {}
+
+mmap_reader::~mmap_reader() {
+    if (begin != end) {
+        munmap(const_cast<char *>(begin), end - begin);
+    }
+}
+
+stream_reader::stream_reader(std::istream &_source, size_t _chunk_bits) : source(_source), chunk_bits(_chunk_bits) {}
+
+bool stream_reader::fill() const {
+    if (eof) {
+        return false;
+    }
+    const size_t chunk_size = size_t(1) << chunk_bits;
+    const size_t used = filled & (chunk_size - 1);
+    if (used == 0) {
+        // 新しいチャンクを確保する(破棄したものがあれば再利用する)
+        if (spares.empty()) {
+            chunks.emplace_back(new char[chunk_size]);
+        } else {
+            chunks.emplace_back(std::move(spares.back()));
+            spares.pop_back();
+        }
+    }
+
+    char *const dest = chunks.back().get() + used;
+    const auto n = source.rdbuf()->sgetn(dest, chunk_size - used);
+    if (n <= 0) {
+        eof = true;
+        if (used == 0) {
+            spares.emplace_back(std::move(chunks.back()));
+            chunks.pop_back();
+        }
+        return false;
+    }
+    lines.scan(std::string_view(dest, n));
+    filled += n;
+    return true;
+}
+
+void stream_reader::release() {
+    size_t keep = offset;
+    if (!pins.empty()) {
+        keep = std::min(keep, pins.front());
+    }
+    const size_t chunk_size = size_t(1) << chunk_bits;
+    while (!chunks.empty() && base + chunk_size <= keep && base + chunk_size <= filled) {
+        spares.emplace_back(std::move(chunks.front()));
+        chunks.pop_front();
+        base += chunk_size;
+    }
+    lines.trim(base);
+}
+
+std::optional<char> stream_reader::peek() const {
+    if (offset == filled && !fill()) {
         return std::nullopt;
     }
-    return *iter;
+    const size_t index = offset - base;
+    return chunks[index >> chunk_bits][index & ((size_t(1) << chunk_bits) - 1)];
 }
 
-std::optional<char> string_reader::next() {
-    if (iter == end) {
+std::optional<char> stream_reader::next() {
+    const auto c = peek();
+    if (!c) {
         return std::nullopt;
     }
-    pos.next(*iter);
-    return *(iter++);
+    offset++;
+    // チャンクを読み終えたら不要なものを破棄する
+    if ((offset & ((size_t(1) << chunk_bits) - 1)) == 0) {
+        release();
+    }
+    return c;
+}
+
+void stream_reader::set_offset(size_t _offset) {
+    // pinされていない位置へは戻れない
+    assert(base <= _offset && _offset <= filled);
+    offset = _offset;
+    release();
+}
+
+position stream_reader::locate(size_t _offset) const {
+    assert(base <= _offset && _offset <= filled);
+    return lines.locate(_offset);
+}
+
+std::string_view stream_reader::window() const {
+    if (offset == filled && !fill()) {
+        return {};
+    }
+    // 現在のチャンクの終わりまで
+    const size_t chunk_size = size_t(1) << chunk_bits;
+    const size_t index = offset - base;
+    const size_t last = std::min(filled - base, (index | (chunk_size - 1)) + 1);
+    return std::string_view(chunks[index >> chunk_bits].get() + (index & (chunk_size - 1)), last - index);
+}
+
+void stream_reader::pin(size_t offset) {
+    assert(pins.empty() || pins.back() <= offset);
+    pins.push_back(offset);
 }
 
-void string_reader::set_position(const position &p) {
-    pos = p;
-    iter = begin + p.offset;
+void stream_reader::unpin(size_t offset) {
+    // 同じ位置のうち最後にpinしたものを外す(残りは昇順のまま)
+    const auto iter = std::find(pins.rbegin(), pins.rend(), offset);
+    assert(iter != pins.rend());
+    const bool front = std::next(iter) == pins.rend();
+    pins.erase(std::next(iter).base());
+    if (front) {
+        release();
+    }
+}
+
+reader_ptr make_file_reader(const std::string &path) {
+    // FIFOを開くときに書き手を待たないようにO_NONBLOCKで開く
+    const int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    // st_sizeが内容の長さになるのは通常のファイルだけ
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return nullptr;
+    }
+
+    // 空のファイルはマップできないので空の領域として扱う
+    const size_t size = st.st_size;
+    const char *data = nullptr;
+    if (size > 0) {
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close(fd);
+            return nullptr;
+        }
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        data = static_cast<const char *>(mapped);
+    }
+    close(fd); // マップ後はfdを保持する必要はない
+
+    return std::make_shared<mmap_reader>(data, data + size);
 }
 
-} // namespace tokenize::readers
\ No newline at end of file
+} // namespace tokenize::readers
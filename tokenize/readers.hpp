@@ -1,9 +1,17 @@
 #pragma once
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <deque>
+#include <istream>
+#include <ostream>
 #include <memory>
 #include <optional>
+#include <stdint.h>
 #include <stddef.h>
 #include <string>
 #include <string_view>
+#include <vector>
 namespace tokenize::readers {
 
 struct position final {
@@ -18,39 +26,370 @@ struct position final {
     const position &operator=(const position &p);
     bool operator==(const position &p) const;
     bool operator!=(const position &p) const;
-    void next(char c);
+    void next(char c) {
+        offset += 1;
+        if (c != '\n' && c != '\r') {
+            line += 0, number += 1;
+        } else {
+            line += 1, number = 0;
+        }
+    }
+    // bodyをまとめて読み進める
+    void next(std::string_view body);
+};
+
+// 改行('\n'と'\r'をそれぞれ1行とする)の位置の索引
+// 読み取り中は位置を数えず、行・桁が必要になったときにここから求める
+class line_index {
+    std::deque<size_t> newlines;
+    size_t scanned = 0;                  // 走査済みの終端
+    size_t dropped = 0;                  // trimで捨てた改行の数
+    std::optional<size_t> last_dropped; // trimで捨てた最後の改行
+
+public:
+    // [scanned, scanned + body.size())を走査する
+    void scan(std::string_view body);
+    // offsetより前の改行を捨てる(以降はoffset以上の位置のみ求められる)
+    void trim(size_t offset);
+
+    size_t get_scanned() const { return scanned; }
+    position locate(size_t offset) const;
+};
+
+// パーサの結果を(パーサの番号, 開始位置)ごとに記録する表(packrat)
+// 同じ位置で同じパーサを試し直すときは、記録した結果と終了位置をそのまま使う
+// 巻き戻しは近い位置にしか起きないので、固定長の直接写像にして衝突したら上書きする
+// (取りこぼしても読み直すだけで、表は常にキャッシュに載る)
+// 表は一つの入力に対してだけ有効なので、別の入力を読むときはclearする
+class memo_table {
+public:
+    struct entry {
+        uint64_t key = empty; // (id << 48) | offset
+        size_t end = 0;
+        bool result = false;
+    };
+
+private:
+    static constexpr uint64_t empty = UINT64_MAX;
+    std::vector<entry> slots; // 要素数は2の冪
+
+    static uint64_t key_of(uint32_t id, size_t offset) { return uint64_t(id) << 48 | offset; }
+    size_t index_of(uint32_t id, size_t offset) const { return (offset + id * 0x9E3779B1u) & (slots.size() - 1); }
+
+public:
+    memo_table(size_t capacity = 4096);
+
+    const entry *find(uint32_t id, size_t offset) const {
+        const entry &e = slots[index_of(id, offset)];
+        return e.key == key_of(id, offset) ? &e : nullptr;
+    }
+    void insert(uint32_t id, size_t offset, size_t end, bool result) {
+        slots[index_of(id, offset)] = entry{key_of(id, offset), end, result};
+    }
+    void clear();
+    size_t size() const; // 記録している数
+};
+
+// パーサが読み進めてから失敗したこと(読んだ分は戻らない)
+struct diagnostic {
+    enum kind_t : uint8_t { overrun_repeat_min, overrun_repeat_max, overrun, kind_count } kind;
+    enum combinator_t : uint8_t { repeat_range, sum, sigma, static_sigma } combinator;
+    size_t offset; // 失敗したパーサが読み始めた位置
+    size_t end;    // 失敗して止まった位置
+};
+
+// readerごとに診断を受け取る(スレッドごとにreaderを分ければロックしない)
+// recordsでは確保済みの領域に容量まで記録し、文字列にするのはformatを呼んだときだけ
+// countersでは種類ごとの数だけを数える
+class diagnostic_sink {
+public:
+    enum mode_t { records, counters };
+
+private:
+    mode_t mode;
+    size_t capacity;
+    std::vector<diagnostic> recorded;
+    std::array<uint64_t, diagnostic::kind_count> counts{};
+    uint64_t dropped = 0; // 容量を超えて記録しなかった数
+
+public:
+    diagnostic_sink(mode_t _mode = records, size_t _capacity = 256);
+
+    void report(const diagnostic &d) {
+        counts[d.kind]++;
+        if (mode == records && recorded.size() < capacity) {
+            recorded.push_back(d);
+        } else if (mode == records) {
+            dropped++;
+        }
+    }
+    void clear();
+
+    mode_t get_mode() const { return mode; }
+    const std::vector<diagnostic> &get_records() const { return recorded; }
+    uint64_t count(diagnostic::kind_t kind) const { return counts[kind]; }
+    uint64_t total() const;
+    uint64_t get_dropped() const { return dropped; }
+
+    static std::string_view message(diagnostic::kind_t kind);
+    // 記録した診断を1行に1つずつ書き出す
+    void format(std::ostream &) const;
 };
 
 struct reader {
     virtual std::optional<char> peek() const = 0;
     virtual std::optional<char> next() = 0;
-    virtual const position &get_position() const = 0;
-    virtual void set_position(const position &) = 0;
+    virtual size_t get_offset() const = 0;
+    virtual void set_offset(size_t) = 0;
+    // offsetの行・桁を求める(読み取りより重いので必要なときだけ呼ぶ)
+    virtual position locate(size_t offset) const = 0;
+    // offsetへ巻き戻す可能性があることを通知する(pinされた位置より前は破棄してよい)
+    // 全体を保持するreaderでは何もしない
+    virtual void pin(size_t) {}
+    virtual void unpin(size_t) {}
+    // 現在位置から連続して読めるバッファ(まとめて走査するため)
+    // 連続した領域を持たないreaderは空を返してよい
+    virtual std::string_view window() const { return {}; }
+    virtual ~reader() = default;
+
+    // memoを付けたパーサが使う表(nullptrなら記録しない)
+    memo_table *get_memo() const { return memo; }
+    void set_memo(memo_table *_memo) { memo = _memo; }
+    // パーサが診断を書き出す先(nullptrなら捨てる)
+    diagnostic_sink *get_diagnostics() const { return diagnostics; }
+    void set_diagnostics(diagnostic_sink *_diagnostics) { diagnostics = _diagnostics; }
+
+    position get_position() const { return locate(get_offset()); }
+    void set_position(const position &p) { set_offset(p.offset); }
+
+private:
+    memo_table *memo = nullptr;
+    diagnostic_sink *diagnostics = nullptr;
 };
 
 using reader_ptr = std::shared_ptr<reader>;
 using char_opt = std::optional<char>;
 
-class string_reader : public reader {
+// パーサが読み取りに使うハンドル
+// reader_ptrのほか、view_reader *のような具象readerへのポインタも満たす
+template <class R>
+concept reader_handle = requires(R r, size_t offset) {
+    { r->peek() } -> std::same_as<std::optional<char>>;
+    { r->next() } -> std::same_as<std::optional<char>>;
+    { r->get_offset() } -> std::same_as<size_t>;
+    r->set_offset(offset);
+    r->pin(offset);
+    r->unpin(offset);
+    { r->window() } -> std::same_as<std::string_view>;
+};
+
+// スコープ内で位置を保持し、必要なら巻き戻す
+template <reader_handle Reader> class checkpoint {
+    Reader &reader;
+    const size_t keep;
+
+public:
+    checkpoint(Reader &_reader) : reader(_reader), keep(_reader->get_offset()) { reader->pin(keep); }
+    checkpoint(const checkpoint &) = delete;
+    ~checkpoint() { reader->unpin(keep); }
+
+    size_t get_offset() const { return keep; }
+    void restore() const { reader->set_offset(keep); }
+};
+
+// 借用したバッファをコピーせずに読む
+// バッファはview_readerより長く生存しなければならない(確保は一切しない)
+class view_reader : public reader {
+protected:
+    const char *begin, *end, *iter;
+    mutable line_index lines; // locateされたところまで遅延して作る
+
+    void reset(std::string_view _body);
+
+public:
+    view_reader(std::string_view _body);
+    view_reader(const view_reader &) = default;
+    virtual ~view_reader() = default;
+
+    std::string_view view() const { return std::string_view(begin, end - begin); }
+
+    // finalなので具象型から呼べば仮想呼び出しにならずインライン化できる
+    virtual std::optional<char> peek() const override final {
+        if (iter == end) {
+            return std::nullopt;
+        }
+        return *iter;
+    }
+    virtual std::optional<char> next() override final {
+        if (iter == end) {
+            return std::nullopt;
+        }
+        return *(iter++);
+    }
+    virtual size_t get_offset() const override final { return iter - begin; }
+    virtual void set_offset(size_t offset) override final { iter = begin + offset; }
+    virtual position locate(size_t offset) const override;
+    virtual void pin(size_t) override final {}
+    virtual void unpin(size_t) override final {}
+    virtual std::string_view window() const override final { return std::string_view(iter, end - iter); }
+};
+
+static inline reader_ptr make_view_reader(std::string_view src) {
+    return std::dynamic_pointer_cast<reader>(std::make_shared<view_reader>(src));
+}
+
+// 所有権を持たないreader_ptrを作る(確保なし)
+// rはreader_ptrの利用が終わるまで生存しなければならない
+static inline reader_ptr borrow_reader(reader &r) { return reader_ptr(reader_ptr(), &r); }
+
+// 入力をコピーして保持する
+class string_reader : public view_reader {
     std::string body;
-    position pos;
-    const std::string::const_iterator begin, end;
-    std::string::const_iterator iter;
 
 public:
     string_reader(std::string_view _body);
-    string_reader(const string_reader &sr) = default;
-    string_reader(string_reader &&sr) = default;
+    string_reader(const string_reader &sr);
+    string_reader(string_reader &&sr);
     virtual ~string_reader() = default;
-
-    virtual std::optional<char> peek() const override;
-    virtual std::optional<char> next();
-    virtual const position &get_position() const override { return pos; }
-    virtual void set_position(const position &p) override;
 };
 
 static inline reader_ptr make_string_reader(std::string_view src) {
     return std::dynamic_pointer_cast<reader>(std::make_shared<string_reader>(src));
 }
 
+// ファイルを読み取り専用でマップし、コピーせずに読む
+class mmap_reader : public view_reader {
+public:
+    // [_begin, _end)はmmapで確保した領域であり、所有権を受け取る
+    mmap_reader(const char *_begin, const char *_end);
+    mmap_reader(const mmap_reader &) = delete;
+    mmap_reader(mmap_reader &&) = delete;
+    virtual ~mmap_reader();
+};
+
+// パイプやソケットなど終端の分からない入力を固定長チャンク単位で読む
+// pinされた位置と現在位置より前のチャンクは破棄して再利用するので、メモリは有界になる
+class stream_reader : public reader {
+    std::istream &source;
+    const size_t chunk_bits;
+    mutable std::deque<std::unique_ptr<char[]>> chunks; // chunks[i]は[base + (i << chunk_bits), ...)を保持する
+    mutable std::vector<std::unique_ptr<char[]>> spares;
+    mutable size_t base = 0, filled = 0;
+    mutable bool eof = false;
+    mutable line_index lines; // 読み込んだ時点で走査する
+    std::vector<size_t> pins; // 位置の昇順にpinされるので先頭が最小になる(外すのはどの順でもよい)
+    size_t offset = 0;
+
+    bool fill() const;
+    void release();
+
+public:
+    // チャンクは2^_chunk_bitsバイト
+    stream_reader(std::istream &_source, size_t _chunk_bits = 16);
+    stream_reader(const stream_reader &) = delete;
+    virtual ~stream_reader() = default;
+
+    // 保持しているバイト数
+    size_t buffered() const { return chunks.size() << chunk_bits; }
+
+    virtual std::optional<char> peek() const override;
+    virtual std::optional<char> next() override;
+    virtual size_t get_offset() const override { return offset; }
+    virtual void set_offset(size_t offset) override;
+    virtual position locate(size_t offset) const override;
+    virtual void pin(size_t offset) override;
+    virtual void unpin(size_t offset) override;
+    virtual std::string_view window() const override;
+};
+
+// sourceはreaderより長く生存しなければならない
+static inline reader_ptr make_stream_reader(std::istream &source) {
+    return std::dynamic_pointer_cast<reader>(std::make_shared<stream_reader>(source));
+}
+
+// 開けなかった場合と通常のファイルでない場合(ディレクトリ、デバイス、FIFOなど)はnullptrを返す
+reader_ptr make_file_reader(const std::string &path);
+
+// 借用したバッファを読みながら、調べた範囲(先読みを含む)の終端を記録する
+// readerは継承しないが、具象型のポインタとしてreader_handleを満たす
+// windowは空を返すので、パーサは1文字ずつ読むことになり、調べた範囲を取りこぼさない
+class tracking_reader final {
+    const char *begin, *end, *iter;
+    mutable size_t reach = 0;
+    mutable line_index lines;
+
+    void touch() const { reach = std::max<size_t>(reach, iter - begin + 1); }
+
+public:
+    tracking_reader(std::string_view _body) : begin(_body.data()), end(_body.data() + _body.size()), iter(begin) {}
+
+    std::string_view view() const { return std::string_view(begin, end - begin); }
+    // 終端で読もうとした場合もoffset + 1までを調べたものとする
+    size_t get_reach() const { return reach; }
+    void clear_reach() { reach = 0; }
+
+    std::optional<char> peek() const {
+        touch();
+        if (iter == end) {
+            return std::nullopt;
+        }
+        return *iter;
+    }
+    std::optional<char> next() {
+        touch();
+        if (iter == end) {
+            return std::nullopt;
+        }
+        return *(iter++);
+    }
+    size_t get_offset() const { return iter - begin; }
+    void set_offset(size_t offset) { iter = begin + offset; }
+    position locate(size_t offset) const;
+    void pin(size_t) {}
+    void unpin(size_t) {}
+    std::string_view window() const { return {}; }
+};
+
+// 調べた範囲を記録するreader
+template <class R>
+concept reach_tracking = reader_handle<R> && requires(R r) {
+    { r->get_reach() } -> std::same_as<size_t>;
+    r->clear_reach();
+};
+
+// 別のreaderを読みながら、読み戻す直前に読み進めていた位置の最大値を記録する
+// attemptなどが失敗して巻き戻した範囲も含めて、パーサが読み進めた所を知るために使う
+template <reader_handle Reader> class furthest_reader final {
+    Reader &reader;
+    size_t furthest;
+
+public:
+    furthest_reader(Reader &_reader) : reader(_reader), furthest(_reader->get_offset()) {}
+
+    // 読み戻した位置と現在位置のうち遠い方
+    size_t get_furthest() const { return std::max(furthest, reader->get_offset()); }
+
+    std::optional<char> peek() const { return reader->peek(); }
+    std::optional<char> next() { return reader->next(); }
+    size_t get_offset() const { return reader->get_offset(); }
+    void set_offset(size_t offset) {
+        furthest = std::max(furthest, reader->get_offset());
+        reader->set_offset(offset);
+    }
+    position locate(size_t offset) const { return reader->locate(offset); }
+    void pin(size_t offset) { reader->pin(offset); }
+    void unpin(size_t offset) { reader->unpin(offset); }
+    std::string_view window() const { return reader->window(); }
+    memo_table *get_memo() const
+        requires requires { reader->get_memo(); }
+    {
+        return reader->get_memo();
+    }
+    diagnostic_sink *get_diagnostics() const
+        requires requires { reader->get_diagnostics(); }
+    {
+        return reader->get_diagnostics();
+    }
+};
+
 } // namespace tokenize::readers
@@ -1,5 +1,10 @@
 #include "acutest.h"
 #include "readers.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
 using namespace tokenize::readers;
 
 void position_test() {
@@ -19,6 +24,34 @@ void position_test() {
     TEST_ASSERT(p.offset == 3 && p.line == 2 && p.number == 0);
 }
 
+void line_index_test() {
+    line_index lines;
+    lines.scan("ab\ncd\r\ne");
+    TEST_ASSERT(lines.locate(0) == position(0, 0, 0));
+    TEST_ASSERT(lines.locate(2) == position(2, 0, 2));
+    TEST_ASSERT(lines.locate(3) == position(3, 1, 0));
+    TEST_ASSERT(lines.locate(5) == position(5, 1, 2));
+    TEST_ASSERT(lines.locate(7) == position(7, 3, 0));
+    TEST_ASSERT(lines.locate(8) == position(8, 3, 1));
+
+    // same as position::next
+    const std::string body = "x\n\ry\rzz\n" + std::string(40, 'w') + "\n!";
+    lines = line_index();
+    lines.scan(body);
+    position p;
+    for (size_t i = 0; i <= body.size(); i++) {
+        TEST_ASSERT(lines.locate(i) == p);
+        if (i < body.size()) {
+            p.next(body[i]);
+        }
+    }
+
+    // trimmed
+    lines.trim(6);
+    TEST_ASSERT(lines.locate(8) == position(8, 4, 0));
+    TEST_ASSERT(lines.locate(6) == position(6, 3, 1));
+}
+
 void string_reader_test() {
     reader_ptr r = make_string_reader( "a");
 
@@ -46,4 +79,137 @@ void string_reader_test() {
     TEST_ASSERT(reset_next && *reset_next == 'a');
 };
 
-TEST_LIST = {{"position_test", position_test}, {"string_reader_test", string_reader_test}, {nullptr, nullptr}};
\ No newline at end of file
+void view_reader_test() {
+    const std::string body = "ab";
+    view_reader source(body);
+    reader_ptr r = borrow_reader(source);
+
+    // no copy
+    TEST_ASSERT(source.view().data() == body.data());
+
+    const auto p0 = r->get_position();
+    TEST_ASSERT(r->next() == 'a' && r->next() == 'b' && !r->next());
+    r->set_position(p0);
+    TEST_ASSERT(r->peek() == 'a');
+}
+
+void string_reader_copy_test() {
+    string_reader a("xy");
+    a.next();
+    string_reader b(a);
+    TEST_ASSERT(b.view().data() != a.view().data());
+    TEST_ASSERT(b.get_position() == a.get_position());
+    TEST_ASSERT(b.next() == 'y' && !b.next());
+}
+
+void file_reader_test() {
+    char path[] = "/tmp/silang_readers_test_XXXXXX";
+    const int fd = mkstemp(path);
+    TEST_ASSERT(fd >= 0);
+    TEST_ASSERT(write(fd, "ab\nc", 4) == 4);
+    close(fd);
+
+    reader_ptr r = make_file_reader(path);
+    TEST_ASSERT(r != nullptr);
+    const auto p0 = r->get_position();
+
+    TEST_ASSERT(r->next() == 'a' && r->next() == 'b' && r->next() == '\n');
+    TEST_ASSERT(r->get_position().line == 1 && r->get_position().number == 0);
+    TEST_ASSERT(r->next() == 'c' && !r->next());
+
+    // reset position
+    r->set_position(p0);
+    TEST_ASSERT(r->peek() == 'a');
+
+    unlink(path);
+}
+
+void file_reader_empty_test() {
+    char path[] = "/tmp/silang_readers_test_XXXXXX";
+    const int fd = mkstemp(path);
+    TEST_ASSERT(fd >= 0);
+    close(fd);
+
+    reader_ptr r = make_file_reader(path);
+    TEST_ASSERT(r != nullptr && !r->peek());
+    unlink(path);
+
+    // missing file
+    TEST_ASSERT(make_file_reader(path) == nullptr);
+}
+
+void file_reader_special_test() {
+    // only regular files can be mapped by size
+    TEST_CHECK(make_file_reader("/dev/null") == nullptr);
+    TEST_CHECK(make_file_reader("/tmp") == nullptr);
+
+    char path[] = "/tmp/silang_readers_test_XXXXXX";
+    const int fd = mkstemp(path);
+    TEST_ASSERT(fd >= 0);
+    close(fd);
+    unlink(path);
+    TEST_ASSERT(mkfifo(path, 0600) == 0);
+    TEST_CHECK(make_file_reader(path) == nullptr); // does not wait for a writer
+    unlink(path);
+}
+
+void stream_reader_test() {
+    std::istringstream source("abcdefghij");
+    stream_reader r(source, 2); // 4 bytes chunk
+
+    TEST_ASSERT(r.peek() == 'a');
+    for (char c = 'a'; c <= 'j'; c++) {
+        TEST_ASSERT(r.next() == c);
+    }
+    TEST_ASSERT(!r.next());
+    TEST_ASSERT(r.get_position().offset == 10);
+    // consumed chunks are released
+    TEST_ASSERT(r.buffered() <= 4);
+}
+
+void stream_reader_pin_test() {
+    std::istringstream source("abcdefghij");
+    stream_reader r(source, 2);
+    reader_ptr ptr = borrow_reader(r);
+
+    r.next();
+    {
+        const checkpoint keep(ptr);
+        for (int i = 0; i < 8; i++) {
+            r.next();
+        }
+        // pinned chunks are kept
+        TEST_ASSERT(r.buffered() >= 12);
+        keep.restore();
+        TEST_ASSERT(r.next() == 'b');
+    }
+    for (int i = 0; i < 7; i++) {
+        r.next();
+    }
+    TEST_ASSERT(r.buffered() <= 4);
+    TEST_ASSERT(r.next() == 'j' && !r.next());
+}
+
+void stream_reader_locate_test() {
+    std::istringstream source("ab\ncd\nef\ngh");
+    stream_reader r(source, 2);
+    while (r.get_offset() < 8) {
+        r.next();
+    }
+    TEST_ASSERT(r.get_position() == position(8, 2, 2));
+    r.next();
+    TEST_ASSERT(r.get_position() == position(9, 3, 0));
+}
+
+TEST_LIST = {{"position_test", position_test},
+             {"line_index_test", line_index_test},
+             {"string_reader_test", string_reader_test},
+             {"view_reader_test", view_reader_test},
+             {"string_reader_copy_test", string_reader_copy_test},
+             {"stream_reader_test", stream_reader_test},
+             {"stream_reader_pin_test", stream_reader_pin_test},
+             {"stream_reader_locate_test", stream_reader_locate_test},
+             {"file_reader_test", file_reader_test},
+             {"file_reader_empty_test", file_reader_empty_test},
+             {"file_reader_special_test", file_reader_special_test},
+             {nullptr, nullptr}};
\ No newline at end of file
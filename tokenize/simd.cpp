@@ -0,0 +1,98 @@
+#include "simd.hpp"
+#include <stdint.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TOKENIZE_SIMD_X86
+#endif
+namespace tokenize::simd {
+
+const char *find_either(const char *begin, const char *end, char a, char b) {
+    const char *iter = begin;
+#if defined(__SSE2__)
+    // 16バイトずつ比較する
+    const __m128i va = _mm_set1_epi8(a), vb = _mm_set1_epi8(b);
+    for (; end - iter >= 16; iter += 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(iter));
+        const __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(block, va), _mm_cmpeq_epi8(block, vb));
+        if (const unsigned mask = _mm_movemask_epi8(hit); mask != 0) {
+            return iter + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; iter != end; iter++) {
+        if (*iter == a || *iter == b) {
+            return iter;
+        }
+    }
+    return end;
+}
+
+#if defined(TOKENIZE_SIMD_X86)
+__attribute__((target("avx2"))) static size_t span_avx2(const char_class &cls, const char *begin, const char *end) {
+    const __m256i low = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cls.low)));
+    const __m256i high = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cls.high)));
+    const __m256i nibble = _mm256_set1_epi8(0x0f), zero = _mm256_setzero_si256();
+    const char *iter = begin;
+    for (; end - iter >= 32; iter += 32) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(iter));
+        const __m256i l = _mm256_shuffle_epi8(low, _mm256_and_si256(block, nibble));
+        const __m256i h = _mm256_shuffle_epi8(high, _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble));
+        const unsigned miss = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(l, h), zero));
+        if (miss != 0) {
+            return iter - begin + __builtin_ctz(miss);
+        }
+    }
+    for (; iter != end && cls.contains(*iter); iter++) {
+    }
+    return iter - begin;
+}
+
+__attribute__((target("ssse3"))) static size_t span_ssse3(const char_class &cls, const char *begin, const char *end) {
+    const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cls.low));
+    const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cls.high));
+    const __m128i nibble = _mm_set1_epi8(0x0f), zero = _mm_setzero_si128();
+    const char *iter = begin;
+    for (; end - iter >= 16; iter += 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(iter));
+        const __m128i l = _mm_shuffle_epi8(low, _mm_and_si128(block, nibble));
+        const __m128i h = _mm_shuffle_epi8(high, _mm_and_si128(_mm_srli_epi16(block, 4), nibble));
+        const unsigned miss = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(l, h), zero));
+        if (miss != 0) {
+            return iter - begin + __builtin_ctz(miss);
+        }
+    }
+    for (; iter != end && cls.contains(*iter); iter++) {
+    }
+    return iter - begin;
+}
+#endif
+
+static size_t span_scalar(const char_class &cls, const char *begin, const char *end) {
+    const char *iter = begin;
+    for (; iter != end && cls.contains(*iter); iter++) {
+    }
+    return iter - begin;
+}
+
+size_t char_class::span(const char *begin, const char *end) const {
+    // 実行環境で使える命令を一度だけ調べる
+    using span_t = size_t (*)(const char_class &, const char *, const char *);
+    static const span_t impl = []() -> span_t {
+#if defined(TOKENIZE_SIMD_X86)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return span_avx2;
+        }
+        if (__builtin_cpu_supports("ssse3")) {
+            return span_ssse3;
+        }
+#endif
+        return span_scalar;
+    }();
+    return impl(*this, begin, end);
+}
+
+} // namespace tokenize::simd
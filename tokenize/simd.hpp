@@ -0,0 +1,124 @@
+#pragma once
+#include <bit>
+#include <stddef.h>
+#include <stdint.h>
+namespace tokenize::simd {
+
+// 256文字の集合
+// std::bitset<256>と同じように使え、定数式の中でも組み立てられる
+class char_set {
+    uint64_t words[4] = {};
+
+public:
+    constexpr char_set() = default;
+    constexpr char_set(unsigned long long bits) : words{bits, 0, 0, 0} {}
+
+    constexpr bool test(size_t i) const { return words[i >> 6] >> (i & 63) & 1; }
+    constexpr char_set &set(size_t i, bool value = true) {
+        const uint64_t bit = uint64_t(1) << (i & 63);
+        words[i >> 6] = value ? words[i >> 6] | bit : words[i >> 6] & ~bit;
+        return *this;
+    }
+    constexpr char_set &reset(size_t i) { return set(i, false); }
+    constexpr size_t count() const {
+        return std::popcount(words[0]) + std::popcount(words[1]) + std::popcount(words[2]) + std::popcount(words[3]);
+    }
+    constexpr bool any() const { return (words[0] | words[1] | words[2] | words[3]) != 0; }
+    constexpr bool none() const { return !any(); }
+
+    constexpr char_set operator~() const {
+        char_set r;
+        for (size_t i = 0; i < 4; i++) {
+            r.words[i] = ~words[i];
+        }
+        return r;
+    }
+    constexpr char_set &operator|=(const char_set &x) {
+        for (size_t i = 0; i < 4; i++) {
+            words[i] |= x.words[i];
+        }
+        return *this;
+    }
+    constexpr char_set &operator&=(const char_set &x) {
+        for (size_t i = 0; i < 4; i++) {
+            words[i] &= x.words[i];
+        }
+        return *this;
+    }
+    constexpr char_set &operator^=(const char_set &x) {
+        for (size_t i = 0; i < 4; i++) {
+            words[i] ^= x.words[i];
+        }
+        return *this;
+    }
+    constexpr char_set operator<<(size_t n) const {
+        char_set r;
+        for (size_t i = n; i < 256; i++) {
+            r.set(i, test(i - n));
+        }
+        return r;
+    }
+    constexpr char_set operator>>(size_t n) const {
+        char_set r;
+        for (size_t i = n; i < 256; i++) {
+            r.set(i - n, test(i));
+        }
+        return r;
+    }
+    friend constexpr char_set operator|(char_set x, const char_set &y) { return x |= y; }
+    friend constexpr char_set operator&(char_set x, const char_set &y) { return x &= y; }
+    friend constexpr char_set operator^(char_set x, const char_set &y) { return x ^= y; }
+    constexpr bool operator==(const char_set &) const = default;
+};
+
+// [begin, end)からaまたはbが最初に現れる位置を返す(なければend)
+const char *find_either(const char *begin, const char *end, char a, char b);
+
+// 文字クラスを下位・上位ニブルの表で表す(shufti)
+// 文字cはlow[c & 15] & high[c >> 4]が0でなければクラスに含まれる
+// 上位ニブルごとの下位ニブル集合が8種類を超えるクラスは表せない(validがfalseになる)
+struct char_class {
+    uint8_t low[16] = {}, high[16] = {};
+    bool valid = false;
+
+    constexpr char_class() = default;
+    constexpr char_class(const char_set &match);
+
+    bool contains(unsigned char c) const { return (low[c & 15] & high[c >> 4]) != 0; }
+    // 先頭から連続してクラスに含まれる文字数を返す(validのときのみ)
+    size_t span(const char *begin, const char *end) const;
+};
+
+constexpr char_class::char_class(const char_set &match) {
+    // 上位ニブルごとの下位ニブル集合をまとめてバケットに割り当てる
+    uint16_t buckets[8] = {};
+    size_t used = 0;
+    for (unsigned h = 0; h < 16; h++) {
+        uint16_t lows = 0;
+        for (unsigned l = 0; l < 16; l++) {
+            lows |= match.test(h << 4 | l) << l;
+        }
+        if (lows == 0) {
+            continue;
+        }
+        size_t b = 0;
+        for (; b < used && buckets[b] != lows; b++) {
+        }
+        if (b == used) {
+            if (used == 8) {
+                *this = char_class();
+                return;
+            }
+            buckets[used++] = lows;
+            for (unsigned l = 0; l < 16; l++) {
+                if (lows >> l & 1) {
+                    low[l] |= 1 << b;
+                }
+            }
+        }
+        high[h] = 1 << b;
+    }
+    valid = true;
+}
+
+} // namespace tokenize::simd
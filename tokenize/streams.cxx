@@ -0,0 +1,95 @@
+#pragma once
+namespace tokenize::streams {
+
+template <reader_handle Reader, token_like T>
+token_stream<Reader, T>::token_stream(Reader _reader, size_t lookahead)
+    : reader(_reader), ring(lookahead), offset(_reader->get_offset()) {
+    assert(lookahead > 0);
+}
+
+template <reader_handle Reader, token_like T> token_stream<Reader, T>::~token_stream() {
+    if (count > 0) {
+        reader->unpin(pinned);
+    }
+    while (!marks.empty()) {
+        unmark();
+    }
+}
+
+// 先読みを1つ増やす
+template <reader_handle Reader, token_like T> bool token_stream<Reader, T>::fill() {
+    if (failed || count == ring.size()) {
+        return false;
+    }
+    // 先読みがある間は、markされても戻れるようにoffsetをpinしておく
+    if (count == 0) {
+        pinned = offset;
+        reader->pin(pinned);
+    }
+    entry &e = ring[(head + count) % ring.size()];
+    if (!tokens::tokenize(reader, e.t)) {
+        failed = true;
+        if (count == 0) {
+            reader->unpin(pinned);
+        }
+        return false;
+    }
+    e.end = reader->get_offset();
+    count++;
+    return true;
+}
+
+template <reader_handle Reader, token_like T> const T *token_stream<Reader, T>::peek(size_t k) {
+    assert(k < ring.size());
+    while (count <= k) {
+        if (!fill()) {
+            return nullptr;
+        }
+    }
+    return &ring[(head + k) % ring.size()].t;
+}
+
+template <reader_handle Reader, token_like T> bool token_stream<Reader, T>::skip() {
+    if (!peek()) {
+        return false;
+    }
+    offset = ring[head].end;
+    head = (head + 1) % ring.size(), count--;
+    if (count == 0) {
+        reader->unpin(pinned);
+    }
+    return true;
+}
+
+template <reader_handle Reader, token_like T> bool token_stream<Reader, T>::next(T &t) {
+    if (!peek()) {
+        return false;
+    }
+    t = std::move(ring[head].t);
+    return skip();
+}
+
+template <reader_handle Reader, token_like T> void token_stream<Reader, T>::mark() {
+    reader->pin(offset);
+    marks.push_back(offset);
+}
+
+template <reader_handle Reader, token_like T> void token_stream<Reader, T>::reset() {
+    assert(!marks.empty());
+    // 先読みを捨てて読み直す
+    if (count > 0) {
+        reader->unpin(pinned);
+    }
+    offset = marks.back();
+    reader->set_offset(offset);
+    head = count = 0, failed = false;
+    unmark();
+}
+
+template <reader_handle Reader, token_like T> void token_stream<Reader, T>::unmark() {
+    assert(!marks.empty());
+    reader->unpin(marks.back());
+    marks.pop_back();
+}
+
+} // namespace tokenize::streams
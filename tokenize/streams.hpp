@@ -0,0 +1,80 @@
+#pragma once
+#include "tokens.hpp"
+#include <assert.h>
+#include <iterator>
+#include <stddef.h>
+#include <vector>
+namespace tokenize::streams {
+using readers::reader_handle;
+using tokens::token_like, tokens::token;
+
+// 要求されたときに1トークンずつ字句解析する
+// 先読みはlookahead個までで、読み終えたトークンは保持しないので、メモリは入力の大きさによらない
+// markした位置へはresetで戻れる(readerはその位置をpinして保持する)
+// 先読みがある間は先読みの先頭もpinするので、先読みした後にmarkしてもよい
+template <reader_handle Reader, token_like T = token> class token_stream {
+    struct entry {
+        T t;
+        size_t end; // 読み終えた位置
+    };
+    Reader reader;
+    std::vector<entry> ring; // 先読みしたトークンの環状バッファ
+    size_t head = 0, count = 0;
+    size_t offset;              // 次に返すトークンを読み始める位置
+    size_t pinned = 0;          // 先読みがある間pinしている位置
+    bool failed = false;        // これ以上読めない
+    std::vector<size_t> marks;  // 後入れ先出し
+
+    bool fill();
+
+public:
+    class iterator;
+
+    token_stream(Reader _reader, size_t lookahead = 1);
+    token_stream(const token_stream &) = delete;
+    ~token_stream();
+
+    // k個先のトークン(k < lookahead)、なければnullptr
+    const T *peek(size_t k = 0);
+    // 次のトークンを取り出す
+    bool next(T &t);
+    // 次のトークンを読み飛ばす
+    bool skip();
+
+    // 現在位置を覚える
+    void mark();
+    // 最後にmarkした位置へ戻り、その位置を忘れる
+    void reset();
+    // 最後にmarkした位置を忘れる
+    void unmark();
+
+    size_t get_offset() const { return offset; }
+    size_t get_lookahead() const { return ring.size(); }
+
+    iterator begin() { return iterator(this); }
+    std::default_sentinel_t end() const { return {}; }
+};
+
+template <reader_handle Reader, token_like T> class token_stream<Reader, T>::iterator {
+    token_stream *stream = nullptr;
+
+public:
+    using value_type = T;
+    using difference_type = ptrdiff_t;
+
+    iterator() = default;
+    explicit iterator(token_stream *_stream) : stream(_stream) {}
+
+    const T &operator*() const { return *stream->peek(); }
+    const T *operator->() const { return stream->peek(); }
+    iterator &operator++() {
+        stream->skip();
+        return *this;
+    }
+    void operator++(int) { stream->skip(); }
+    bool operator==(std::default_sentinel_t) const { return stream->peek() == nullptr; }
+};
+
+} // namespace tokenize::streams
+
+#include "streams.cxx"
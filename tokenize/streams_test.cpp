@@ -0,0 +1,129 @@
+#include "acutest.h"
+#include "streams.hpp"
+#include "tokenize.hpp"
+#include <sstream>
+
+using namespace tokenize;
+using tokenize::readers::stream_reader;
+using tokenize::streams::token_stream;
+
+static_assert(std::input_iterator<token_stream<view_reader *>::iterator>);
+
+void token_stream_test() {
+    const std::string src = "int x = 1;\n/* c */ y += 2.5";
+    std::vector<token> expect;
+    {
+        auto reader = make_view_reader(src);
+        tokenize_all(reader, expect);
+    }
+
+    view_reader source(src);
+    token_stream stream(&source);
+    size_t i = 0;
+    for (const token &t : stream) {
+        TEST_ASSERT(i < expect.size());
+        TEST_CHECK(t.id == expect[i].id && t.pos == expect[i].pos && t.text == expect[i].text);
+        i++;
+    }
+    TEST_CHECK(i == expect.size());
+    TEST_CHECK(!stream.peek());
+}
+
+void token_stream_lazy_test() {
+    const std::string src = "a b c d e";
+    view_reader source(src);
+    token_stream stream(&source, 2);
+
+    // only what is asked for is lexed
+    TEST_ASSERT(stream.peek()->text == "a");
+    TEST_CHECK(source.get_offset() == 1);
+    TEST_ASSERT(stream.peek(1)->text == "b");
+    TEST_CHECK(source.get_offset() == 3);
+
+    token t;
+    TEST_ASSERT(stream.next(t) && t.text == "a");
+    TEST_CHECK(stream.get_offset() == 1);
+    TEST_ASSERT(stream.peek(1)->text == "c");
+}
+
+void token_stream_mark_test() {
+    const std::string src = "a b c d";
+    view_reader source(src);
+    token_stream<view_reader *, lexeme> stream(&source, 3);
+
+    lexeme l;
+    TEST_ASSERT(stream.next(l) && l.text(src) == "a");
+    stream.mark();
+    TEST_ASSERT(stream.next(l) && l.text(src) == "b");
+    stream.mark();
+    TEST_ASSERT(stream.next(l) && stream.next(l) && l.text(src) == "d");
+    TEST_ASSERT(!stream.next(l));
+
+    stream.reset();
+    TEST_ASSERT(stream.next(l) && l.text(src) == "c");
+    stream.reset();
+    TEST_ASSERT(stream.peek(2)->text(src) == "d");
+    TEST_ASSERT(stream.next(l) && l.text(src) == "b");
+
+    stream.mark();
+    stream.unmark();
+    TEST_ASSERT(stream.next(l) && l.text(src) == "c");
+}
+
+void token_stream_reader_test() {
+    // reset over released chunks
+    std::istringstream input("alpha beta gamma delta epsilon");
+    stream_reader source(input, 2);
+    token_stream stream(&source);
+
+    token t;
+    TEST_ASSERT(stream.next(t) && t.text == "alpha");
+    stream.mark();
+    TEST_ASSERT(stream.next(t) && stream.next(t) && stream.next(t) && t.text == "delta");
+    stream.reset();
+    TEST_ASSERT(stream.next(t) && t.text == "beta" && t.pos == position(6, 0, 6));
+}
+
+void token_stream_mark_after_peek_test() {
+    // marking with lookahead in the ring keeps the chunks behind it
+    std::istringstream input("alpha beta gamma delta epsilon");
+    stream_reader source(input, 2);
+    token_stream stream(&source, 2);
+
+    token t;
+    TEST_ASSERT(stream.next(t) && t.text == "alpha");
+    TEST_ASSERT(stream.peek(1) && stream.peek(1)->text == "gamma");
+    stream.mark();
+    TEST_ASSERT(stream.next(t) && stream.next(t) && stream.next(t) && t.text == "delta");
+    stream.reset();
+    TEST_ASSERT(stream.next(t) && t.text == "beta" && t.pos == position(6, 0, 6));
+    TEST_ASSERT(stream.next(t) && t.text == "gamma");
+}
+
+void token_stream_nested_mark_test() {
+    // destroying a stream that still holds nested marks unpins them newest first
+    std::istringstream input("alpha beta gamma delta");
+    stream_reader source(input, 2);
+    {
+        token_stream stream(&source);
+        token t;
+        stream.mark();
+        TEST_ASSERT(stream.next(t) && t.text == "alpha");
+        stream.mark();
+        TEST_ASSERT(stream.next(t) && t.text == "beta");
+    }
+    // nothing stays pinned, so reading on releases the chunks behind
+    auto reader = &source;
+    std::vector<token> rest;
+    TEST_ASSERT(tokenize_all(reader, rest));
+    TEST_ASSERT(rest.size() == 2 && rest[0].text == "gamma");
+    TEST_CHECK(source.buffered() <= 8);
+}
+
+TEST_LIST = {{"token_stream_test", token_stream_test},
+             {"token_stream_lazy_test", token_stream_lazy_test},
+             {"token_stream_mark_test", token_stream_mark_test},
+             {"token_stream_reader_test", token_stream_reader_test},
+             {"token_stream_mark_after_peek_test", token_stream_mark_after_peek_test},
+             {"token_stream_nested_mark_test", token_stream_nested_mark_test},
+             {nullptr, nullptr}};
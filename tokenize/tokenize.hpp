@@ -1,12 +1,40 @@
 #pragma once
+#include "automata.hpp"
+#include "batch.hpp"
+#include "buffers.hpp"
+#include "incremental.hpp"
+#include "numbers.hpp"
+#include "parallel.hpp"
 #include "parsers.hpp"
+#include "profile.hpp"
 #include "readers.hpp"
+#include "streams.hpp"
 #include "tokens.hpp"
+#include "writers.hpp"
 namespace tokenize {
 // readers
-using readers::make_string_reader;
+using readers::make_file_reader, readers::make_stream_reader, readers::make_string_reader, readers::make_view_reader;
+using readers::borrow_reader, readers::view_reader;
 using readers::reader_ptr, readers::position;
+using readers::diagnostic, readers::diagnostic_sink;
 // parsers
-using tokens::token, tokens::token_id;
+using tokens::lexeme, tokens::token, tokens::token_id;
 using tokens::tokenize, tokens::tokenize_all;
+using tokens::tokenize_all_recovering, tokens::tokenize_recovering;
+// buffers
+using buffers::symbol_table, buffers::token_buffer, buffers::tokenize_all;
+// automata
+using automata::lexer;
+// batch
+using batch::batch_result, batch::tokenize_files;
+// incremental
+using incremental::document, incremental::retokenize, incremental::tokenize_document;
+// numbers
+using numbers::decode_integer, numbers::decode_real;
+// parallel
+using parallel::tokenize_parallel;
+// streams
+using streams::token_stream;
+// writers
+using writers::format_t, writers::parse_format, writers::token_writer, writers::writer;
 } // namespace tokenize
\ No newline at end of file
@@ -1,32 +1,504 @@
 #include "tokenize.hpp"
+#include <algorithm>
+#include <charconv>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <new>
+#include <random>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// tokenize_benchmark [--mix=a,b] [--size=1K,1M] [--engine=a,b] [--repeat=N] [--warmup=N] [--seed=N]
+//                    [--json=path] [--baseline=path] [--kinds]
+// 種を固定して合成した入力を各実装で字句解析し、中央値からMB/s, tokens/s, ns/tokenと確保回数を求める
+// --jsonで結果を書き出し、--baselineで以前の結果と比べる
+
+// 確保回数(このプログラムは単一スレッド)
+static size_t allocations = 0;
+
+void *operator new(size_t n) {
+    allocations++;
+    if (void *p = std::malloc(n ? n : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void *operator new[](size_t n) {
+    allocations++;
+    if (void *p = std::malloc(n ? n : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+// 呼び出し側に展開されると、newで得た領域をfreeしているとgccが警告する
+[[gnu::noinline]] void operator delete(void *p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete[](void *p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void *p, size_t) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete[](void *p, size_t) noexcept { std::free(p); }
+
+namespace {
+using namespace tokenize;
+
+// 入力の生成
+
+// 断片の種類
+enum fragment { identifier, keyword, number, real, comment, text, operation, fragment_count };
+
+struct mix {
+    const char *name;
+    unsigned int weights[fragment_count];
+};
+
+// 断片の出やすさ(identifier, keyword, number, real, comment, text, operation)
+const mix mixes[] = {
+    {"identifier", {60, 10, 2, 1, 1, 1, 25}}, {"number", {8, 2, 40, 30, 1, 1, 18}},
+    {"comment", {10, 2, 2, 1, 60, 1, 24}},    {"string", {10, 2, 2, 1, 1, 60, 24}},
+    {"operator", {10, 2, 5, 2, 1, 1, 79}},    {"mixed", {30, 8, 10, 5, 8, 8, 31}},
+};
+
+class generator {
+    std::mt19937_64 rng;
+
+    size_t uniform(size_t lo, size_t hi) { return lo + rng() % (hi - lo + 1); }
+    char pick(std::string_view s) { return s[rng() % s.size()]; }
+
+    void digits(std::string &out, std::string_view alphabet, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            if (i > 0 && uniform(0, 7) == 0) {
+                out.push_back('_');
+            }
+            out.push_back(pick(alphabet));
+        }
+    }
+
+    // 基数を選んで接頭辞を書き、使える桁を返す
+    std::string_view prefix(std::string &out) {
+        switch (uniform(0, 7)) {
+        case 0:
+            out += "0b";
+            return "01";
+        case 1:
+            out += "0o";
+            return "01234567";
+        case 2:
+            out += "0x";
+            return "0123456789abcdefABCDEF";
+        default:
+            return "0123456789";
+        }
+    }
+
+public:
+    generator(uint64_t seed) : rng(seed) {}
+
+    void append(std::string &out, fragment f) {
+        static constexpr std::string_view keywords[] = {"bool", "int", "uint", "char", "str", "func", "true", "false"};
+        // "/"と"/="は空白の読み飛ばしがコメントの始まりとして読んでしまい、字句解析が止まるので出さない
+        static constexpr std::string_view operations[] = {
+            "=",  ":=", "+",  "-",  "*",  "%",  "+=", "-=",  "*=",  "%=",  "==", "=!", ">", ">=", "<", "<=",
+            "~",  "&",  "|",  "^",  ">>", "<<", "&=", "|=",  "^=",  ">>=", "<<=", "!", "&&", "||", "^^", "&&=",
+            "||=", "^^=", ".", "->", "@",  "?",  "(",  ")",  "()",  "{",   "}",   "[",  "]",  ";",  ",",  ":"};
+        switch (f) {
+        case identifier:
+            // 型名やtrue, falseで始まらないように先頭は大文字か'_'にする
+            out.push_back(pick("ABCDEFGHIJKLMNOPQRSTUVWXYZ_"));
+            for (size_t i = uniform(0, 15); i > 0; i--) {
+                out.push_back(pick("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_"));
+            }
+            break;
+        case keyword:
+            out += keywords[rng() % std::size(keywords)];
+            break;
+        case number: {
+            const std::string_view alphabet = prefix(out);
+            digits(out, alphabet, uniform(1, 12));
+            break;
+        }
+        case real: {
+            const std::string_view alphabet = prefix(out);
+            digits(out, alphabet, uniform(1, 6));
+            out.push_back('.');
+            digits(out, alphabet, uniform(1, 8));
+            // 0xではeは桁なので指数を付けない
+            if (alphabet.size() <= 10 && uniform(0, 2) == 0) {
+                out.push_back(pick("eE"));
+                out += std::to_string(int(uniform(0, 40)) - 20);
+            }
+            break;
+        }
+        case comment:
+            if (uniform(0, 1) == 0) {
+                out += "//";
+                for (size_t i = uniform(10, 100); i > 0; i--) {
+                    out.push_back(pick("abcdefghijklmnopqrstuvwxyz    ,.;()=+-*\"'"));
+                }
+                out.push_back('\n');
+            } else {
+                out += "/*";
+                for (size_t i = uniform(10, 200); i > 0; i--) {
+                    out.push_back(pick("abcdefghijklmnopqrstuvwxyz    \n,.;()=+-\"'"));
+                }
+                out += "*/";
+            }
+            break;
+        case text:
+            if (uniform(0, 7) == 0) {
+                out.push_back('\'');
+                out += uniform(0, 3) == 0 ? std::string("\\") + pick("nt'\\") : std::string(1, pick("abcxyz019 "));
+                out.push_back('\'');
+            } else {
+                out.push_back('"');
+                for (size_t i = uniform(0, 80); i > 0; i--) {
+                    if (uniform(0, 15) == 0) {
+                        out.push_back('\\');
+                        out.push_back(pick("nt\"\\"));
+                    } else {
+                        out.push_back(pick("abcdefghijklmnopqrstuvwxyz    0123456789,.;()=+-*/'"));
+                    }
+                }
+                out.push_back('"');
+            }
+            break;
+        case operation:
+            out += operations[rng() % std::size(operations)];
+            break;
+        default:
+            break;
+        }
+    }
+
+    // 断片を空白か改行で区切って、size以上になるまで並べる
+    std::string corpus(const mix &m, size_t size) {
+        std::discrete_distribution<int> choose(std::begin(m.weights), std::end(m.weights));
+        std::string out;
+        out.reserve(size + 256);
+        while (out.size() < size) {
+            append(out, fragment(choose(rng)));
+            out.push_back(uniform(0, 9) == 0 ? '\n' : ' ');
+        }
+        return out;
+    }
+};
+
+// 計測
+
+// 字句解析の実装
+struct engine {
+    const char *name;
+    size_t (*run)(std::string_view); // トークン数を返す
+};
+
+// 毎回新しい出力に書き出す(確保も計測に含める)
+const engine engines[] = {
+    {"token",
+     [](std::string_view s) {
+         view_reader source(s);
+         view_reader *reader = &source;
+         std::vector<token> ts;
+         tokens::tokenize_all(reader, ts);
+         return ts.size();
+     }},
+    {"lexeme",
+     [](std::string_view s) {
+         view_reader source(s);
+         view_reader *reader = &source;
+         std::vector<lexeme> ls;
+         tokens::tokenize_all(reader, ls);
+         return ls.size();
+     }},
+    {"buffer",
+     [](std::string_view s) {
+         view_reader source(s);
+         buffers::token_buffer ts;
+         buffers::tokenize_all(source, ts);
+         return ts.size();
+     }},
+    {"dfa",
+     [](std::string_view s) {
+         view_reader source(s);
+         std::vector<lexeme> ls;
+         automata::tokenize_all(source, ls);
+         return ls.size();
+     }},
+};
+
+struct options {
+    std::vector<std::string> mixes, engines;
+    std::vector<size_t> sizes{1 << 10, 64 << 10, 1 << 20, 16 << 20};
+    size_t repeat = 5, warmup = 1;
+    uint64_t seed = 1;
+    std::string json, baseline;
+    bool kinds = false;
+};
+
+struct result {
+    std::string mix, engine;
+    size_t size = 0, bytes = 0, tokens = 0;
+    size_t iterations = 0; // 1回の計測で繰り返した回数(小さな入力でも1回の計測を20ms以上にする)
+    double median_ns = 0, best_ns = 0, allocations = 0;
+
+    double mb_per_s() const { return bytes * iterations / median_ns * 1e3; }
+    double tokens_per_s() const { return tokens * iterations / median_ns * 1e9; }
+    double ns_per_token() const { return median_ns / (tokens * iterations); }
+    double allocations_per_token() const { return allocations / tokens; }
+};
+
+// トークンの種類ごとの数、バイト数、tokenを作るときの確保回数
+struct kind {
+    size_t tokens = 0, bytes = 0, allocations = 0;
+};
+
+result measure(const options &o, const engine &e, const std::string &mix, size_t size, std::string_view corpus) {
+    using clock = std::chrono::steady_clock;
+    result r{mix, e.name, size, corpus.size()};
+    // 最後の空回しの時間から繰り返す回数を決める
+    double once = 0;
+    for (size_t i = 0; i < std::max<size_t>(o.warmup, 1); i++) {
+        const auto begin = clock::now();
+        r.tokens = e.run(corpus);
+        once = std::chrono::duration<double, std::nano>(clock::now() - begin).count();
+    }
+    r.iterations = size_t(std::max(1.0, std::ceil(2e7 / once)));
+    std::vector<double> samples;
+    for (size_t i = 0; i < o.repeat; i++) {
+        const size_t before = allocations;
+        const auto begin = clock::now();
+        for (size_t k = 0; k < r.iterations; k++) {
+            r.tokens = e.run(corpus);
+        }
+        const auto end = clock::now();
+        r.allocations = double(allocations - before) / r.iterations;
+        samples.push_back(std::chrono::duration<double, std::nano>(end - begin).count());
+    }
+    std::sort(samples.begin(), samples.end());
+    r.median_ns = samples[samples.size() / 2];
+    r.best_ns = samples.front();
+    return r;
+}
+
+// 1トークンずつtokenを作り、確保を種類ごとに数える
+std::map<std::string, kind> measure_kinds(std::string_view corpus, bool &complete) {
+    std::map<std::string, kind> kinds;
+    view_reader source(corpus);
+    view_reader *reader = &source;
+    while (true) {
+        token t;
+        const size_t before = allocations;
+        if (!tokens::tokenize(reader, t)) {
+            break;
+        }
+        std::ostringstream name;
+        name << t.id;
+        kind &k = kinds[name.str()];
+        k.tokens++, k.bytes += t.text.size(), k.allocations += allocations - before;
+    }
+    complete = source.get_offset() == corpus.size();
+    return kinds;
+}
+
+// JSON
+
+std::string quote(std::string_view s) {
+    std::string out = "\"";
+    for (const char c : s) {
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+        }
+        out.push_back(c);
+    }
+    return out + "\"";
+}
+
+// 差分を取りやすいように1行に1つの結果を書く
+void write_json(std::ostream &os, const options &o, const std::vector<result> &results,
+                const std::vector<std::tuple<std::string, size_t, std::map<std::string, kind>>> &kinds) {
+    os << std::setprecision(9);
+    os << "{\n\"seed\": " << o.seed << ", \"repeat\": " << o.repeat << ", \"warmup\": " << o.warmup << ",\n";
+    os << "\"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const result &r = results[i];
+        os << "{\"mix\": " << quote(r.mix) << ", \"size\": " << r.size << ", \"engine\": " << quote(r.engine)
+           << ", \"bytes\": " << r.bytes << ", \"tokens\": " << r.tokens << ", \"iterations\": " << r.iterations
+           << ", \"median_ns\": " << r.median_ns << ", \"best_ns\": " << r.best_ns
+           << ", \"mb_per_s\": " << r.mb_per_s() << ", \"tokens_per_s\": " << r.tokens_per_s()
+           << ", \"ns_per_token\": " << r.ns_per_token() << ", \"allocations_per_token\": " << r.allocations_per_token()
+           << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    os << "],\n\"kinds\": [\n";
+    for (size_t i = 0; i < kinds.size(); i++) {
+        const auto &[mix, size, ks] = kinds[i];
+        size_t j = 0;
+        for (const auto &[name, k] : ks) {
+            os << "{\"mix\": " << quote(mix) << ", \"size\": " << size << ", \"kind\": " << quote(name)
+               << ", \"tokens\": " << k.tokens << ", \"bytes\": " << k.bytes
+               << ", \"allocations_per_token\": " << double(k.allocations) / k.tokens << "}"
+               << (i + 1 < kinds.size() || ++j < ks.size() ? "," : "") << "\n";
+        }
+    }
+    os << "]\n}\n";
+}
+
+// write_jsonが書いた結果の行から数値を取り出す
+bool field(const std::string &line, const std::string &key, std::string &value) {
+    const size_t at = line.find("\"" + key + "\": ");
+    if (at == std::string::npos) {
+        return false;
+    }
+    const size_t begin = at + key.size() + 4;
+    const size_t end = line.find_first_of(",}", begin);
+    value = line.substr(begin, end - begin);
+    if (value.size() >= 2 && value.front() == '"') {
+        value = value.substr(1, value.size() - 2);
+    }
+    return true;
+}
+
+// (mix, size, engine) -> ns/token
+std::map<std::string, double> read_baseline(const std::string &path) {
+    std::map<std::string, double> baseline;
+    std::ifstream in(path);
+    std::string line, mix, size, engine, ns;
+    while (std::getline(in, line)) {
+        if (field(line, "mix", mix) && field(line, "size", size) && field(line, "engine", engine) &&
+            field(line, "ns_per_token", ns)) {
+            baseline[mix + " " + size + " " + engine] = std::stod(ns);
+        }
+    }
+    return baseline;
+}
+
+// 引数
+
+std::vector<std::string> split(std::string_view s) {
+    std::vector<std::string> out;
+    for (size_t begin = 0; begin <= s.size();) {
+        const size_t end = std::min(s.find(',', begin), s.size());
+        out.emplace_back(s.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    return out;
+}
+
+// 10進数だけからなるとき
+template <class T> bool parse_number(std::string_view s, T &n) {
+    const auto [end, error] = std::from_chars(s.data(), s.data() + s.size(), n);
+    return error == std::errc() && end == s.data() + s.size();
+}
+
+// 1K, 64K, 1M, 1Gなど
+bool parse_size(std::string_view s, size_t &n) {
+    const size_t shift = s.ends_with('G') ? 30 : s.ends_with('M') ? 20 : s.ends_with('K') ? 10 : 0;
+    if (!parse_number(shift > 0 ? s.substr(0, s.size() - 1) : s, n) || n > SIZE_MAX >> shift) {
+        return false;
+    }
+    n <<= shift;
+    return true;
+}
+
+bool selected(const std::vector<std::string> &names, std::string_view name) {
+    return names.empty() || std::find(names.begin(), names.end(), name) != names.end();
+}
+
+} // namespace
 
 int main(int argc, char **argv) {
     using namespace std;
-    using namespace tokenize;
-    cout << "benchmark" << endl;
 
-    int n = 1000;
-    if (argc > 1) {
-        n = atoi(argv[1]);
+    options o;
+    for (int i = 1; i < argc; i++) {
+        const string_view arg = argv[i];
+        const string value(arg.substr(std::min(arg.find('=') + 1, arg.size())));
+        bool valid = true;
+        if (arg.starts_with("--mix=")) {
+            o.mixes = split(value);
+        } else if (arg.starts_with("--engine=")) {
+            o.engines = split(value);
+        } else if (arg.starts_with("--size=")) {
+            o.sizes.clear();
+            for (const string &s : split(value)) {
+                valid = valid && parse_size(s, o.sizes.emplace_back());
+            }
+        } else if (arg.starts_with("--repeat=")) {
+            valid = parse_number(value, o.repeat);
+            o.repeat = std::max<size_t>(1, o.repeat);
+        } else if (arg.starts_with("--warmup=")) {
+            valid = parse_number(value, o.warmup);
+        } else if (arg.starts_with("--seed=")) {
+            valid = parse_number(value, o.seed);
+        } else if (arg.starts_with("--json=")) {
+            o.json = value;
+        } else if (arg.starts_with("--baseline=")) {
+            o.baseline = value;
+        } else if (arg == "--kinds") {
+            o.kinds = true;
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            cerr << "unknown option: " << arg << endl;
+            return 1;
+        }
     }
+    const map<string, double> baseline = o.baseline.empty() ? map<string, double>() : read_baseline(o.baseline);
 
-    auto reader = make_string_reader("func main(){\n"
-                                     "  int x=10+10;\n"
-                                     "  return 0\n"
-                                     "}");
-    auto position = reader->get_position();
-    std::vector<token> tokens;
-
-    auto begin = std::chrono::system_clock::now();
+    vector<result> results;
+    vector<tuple<string, size_t, map<string, kind>>> kinds;
+    cout << left << setw(11) << "mix" << right << setw(11) << "bytes" << "  " << left << setw(7) << "engine" << right
+         << setw(10) << "MB/s" << setw(13) << "tokens/s" << setw(10) << "ns/token" << setw(12) << "allocs/tok"
+         << (baseline.empty() ? "" : "    vs base") << endl;
+    for (const mix &m : mixes) {
+        if (!selected(o.mixes, m.name)) {
+            continue;
+        }
+        for (const size_t size : o.sizes) {
+            // 大きさごとに種を変えない(小さな入力は大きな入力の先頭と同じ)
+            const string corpus = generator(o.seed).corpus(m, size);
+            bool complete;
+            kinds.emplace_back(m.name, size, measure_kinds(corpus, complete));
+            if (!complete) {
+                cerr << m.name << " " << size << ": stopped before the end of the corpus" << endl;
+            }
+            for (const engine &e : engines) {
+                if (!selected(o.engines, e.name)) {
+                    continue;
+                }
+                const result r = measure(o, e, m.name, size, corpus);
+                results.push_back(r);
+                cout << left << setw(11) << r.mix << right << setw(11) << r.bytes << "  " << left << setw(7)
+                     << r.engine << right << fixed << setprecision(1) << setw(10) << r.mb_per_s() << setw(13)
+                     << setprecision(0) << r.tokens_per_s() << setw(10) << setprecision(2) << r.ns_per_token()
+                     << setw(12) << setprecision(3) << r.allocations_per_token();
+                const auto base = baseline.find(r.mix + " " + to_string(size) + " " + r.engine);
+                if (base != baseline.end()) {
+                    cout << setw(10) << showpos << setprecision(1) << (r.ns_per_token() / base->second - 1) * 100
+                         << noshowpos << "%";
+                }
+                cout << defaultfloat << endl;
+            }
+            if (o.kinds) {
+                for (const auto &[name, k] : get<2>(kinds.back())) {
+                    cout << "    " << left << setw(24) << name << right << setw(10) << k.tokens << setw(12)
+                         << k.bytes << setw(12) << fixed << setprecision(3) << double(k.allocations) / k.tokens
+                         << defaultfloat << endl;
+                }
+            }
+        }
+    }
 
-    for (int i = 0; i < n; i++) {
-        tokenize_all(reader, tokens);
-        reader->set_position(position);
+    if (!o.json.empty()) {
+        if (o.json == "-") {
+            write_json(cout, o, results, kinds);
+        } else {
+            ofstream out(o.json);
+            write_json(out, o, results, kinds);
+        }
     }
-    auto end = std::chrono::system_clock::now();
-    double elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
-    cout << "elapsed:" << elapsed / n << "ms" << endl;
     return 0;
 }
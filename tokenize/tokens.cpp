@@ -1,212 +1,108 @@
 #include "tokens.hpp"
 #include "tokenize.hpp"
-#include <map>
+#include <array>
+#include <bit>
+#include <string>
 namespace tokenize::tokens {
-const static std::unordered_map<std::string, token_id> operations_table =
-    []() -> std::unordered_map<std::string, token_id> {
-    using enum token_id;
-
-    std::unordered_map<std::string, token_id> t;
-
-    // assign
-    t.insert({{"=", op_assign}, {":=", op_assign_bind}});
-    // arith
-    t.insert({{"+", op_add}, {"-", op_sub}, {"*", op_mul}, {"/", op_div}, {"%", op_mod}});
-    t.insert({
-        {"+=", op_assign_add},
-        {"-=", op_assign_sub},
-        {"*=", op_assign_mul},
-        {"/=", op_assign_div},
-        {"%=", op_assign_mod},
-    });
-
-    // compare
-    t.insert({{"==", op_eq}, {"=!", op_ne}, {">", op_gt}, {">=", op_ge}, {"<", op_lt}, {"<=", op_le}});
-
-    // bit logic
-    t.insert(
-        {{"~", op_bitnot}, {"&", op_bitand}, {"|", op_bitor}, {"^", op_bitxor}, {">>", op_rshfit}, {"<<", op_lshfit}});
-    t.insert({
-        {"&=", op_assign_bitand},
-        {"|=", op_assign_bitor},
-        {"^=", op_assign_bitxor},
-        {">>=", op_assign_rshfit},
-        {"<<=", op_assign_lshfit},
-    });
-
-    // logic
-    t.insert({{"!", op_not}, {"&&", op_and}, {"||", op_or}, {"^^", op_xor}});
-    t.insert({{"&&=", op_assign_and}, {"||=", op_assign_or}, {"^^=", op_assign_xor}});
-
-    // member
-    t.insert({{".", op_member}, {"->", op_arrow}, {"@", op_at}});
-
-    // type
-    t.insert({{"?", op_option}});
-
-    // bracket
-    t.insert({{"(", op_bracket_begin},
-              {")", op_bracket_end},
-              {"()", op_bracket_empty},
-              {"{", op_block_begin},
-              {"}", op_block_end},
-              {"[", op_index_begin},
-              {"]", op_index_end},
-              {";", op_line},
-              {",", op_comma},
-              {":", op_colon}});
-
-    return t;
-}();
-
-const static std::unordered_map<std::string, token_id> types_table = []() {
-    using enum token_id;
-    std::unordered_map<std::string, token_id> t;
-    // types
-    t.insert({{"bool", type_bool},
-              {"int", type_int},
-              {"uint", type_uint},
-              {"char", type_char},
-              {"str", type_str},
-              {"func", type_func}});
-    return t;
-}();
-
 ////////////////////////////////////////////////////////////////////////////////
 //// token /////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
-std::ostream &operator<<(std::ostream &os, token_id id) {
-#define member(x)                                                                                                      \
-    { token_id::x, #x }
-
-    const static std::map<token_id, const char *> table{
+std::string_view name_of(token_id id) {
+    static const auto names = [] {
+        std::array<std::string, token_id_count> names;
+        names.fill("unknown");
+#define member(x) names[size_t(token_id::x)] = #x
         // error
-        member(none),
+        member(none);
+        member(error);
         // literal
-        member(boolean),
-        member(integer),
-        member(real),
-        member(text),
-        member(variable),
-        member(character),
-    };
+        member(boolean);
+        member(integer);
+        member(real);
+        member(text);
+        member(variable);
+        member(character);
 #undef member
-    char buffer[256]; // std::formatはまだまともに使えないので
+        // キーワードの表から引く
+        const auto fill = [&names](const token_table &t, std::string_view prefix) {
+            const auto ids = t.get_ids();
+            const auto keywords = t.get_list().get_keywords();
+            for (size_t i = ids.size(); i-- > 0;) { // 同じ番号は先のキーワードを使う
+                names[size_t(ids[i])] = std::string(prefix) + "[" + std::string(keywords[i]) + "]";
+            }
+        };
+        fill(types, "type");
+        fill(operations, "op");
+        return names;
+    }();
+    const size_t index = size_t(id);
+    return index < names.size() ? std::string_view(names[index]) : std::string_view("unknown");
+}
 
-    if (const auto iter = table.find(id); iter != table.end()) {
-        snprintf(buffer, sizeof(buffer), "%s(%x)", iter->second, (int)id);
-        return os << buffer;
-    }
+std::ostream &operator<<(std::ostream &os, token_id id) {
+    char buffer[16]; // std::formatはまだまともに使えないので
+    snprintf(buffer, sizeof(buffer), "(%x)", (int)id);
+    return os << name_of(id) << buffer;
+}
 
-    for (const auto &[key, value] : operations_table) {
-        if (value == id) {
-            snprintf(buffer, sizeof(buffer), "op[%s](%x)", key.c_str(), (int)id);
-            return os << buffer;
-        }
-    }
+const parsers::match_t &sync_set() {
+    // 読めなかったときにだけ使うので、最初に使うときに求める
+    static const parsers::match_t sync = [] {
+        using namespace parsers;
+        return first_of(token_grammar()).match | first_of(spaces + comment).match;
+    }();
+    return sync;
+}
 
-    for (const auto &[key, value] : types_table) {
-        if (value == id) {
-            snprintf(buffer, sizeof(buffer), "type[%s](%x)", key.c_str(), (int)id);
-            return os << buffer;
-        }
+void token::decode() {
+    negative = overflow = wide = false, bits = 0;
+    if (id == token_id::integer) {
+        const numbers::integer_value v = numbers::decode_integer(text);
+        negative = v.negative, overflow = v.overflow;
+        wide = v.overflow || v.magnitude > UINT64_MAX;
+        bits = uint64_t(v.magnitude);
+    } else if (id == token_id::real) {
+        const numbers::real_value v = numbers::decode_real(text);
+        overflow = v.overflow;
+        bits = std::bit_cast<uint64_t>(v.value);
     }
-
-    snprintf(buffer, sizeof(buffer), "unknown(%x)", (int)id);
-    return os << buffer;
 }
 
-std::ostream &operator<<(std::ostream &os, const token &t) { return os << t.id << ":" << t.text; }
-
-token_table::token_table(const std::unordered_map<std::string, token_id> &_table)
-    : table(_table), list([](const std::unordered_map<std::string, token_id> &ts) {
-          std::vector<std::string> ks;
-          ks.reserve(ts.size());
-          for (const auto &[key, value] : ts) {
-              ks.push_back(key);
-          }
-
-          return ks;
-      }(_table)) {}
-
-bool token_table::operator()(reader_ptr &reader, token &t) const {
-    std::string s;
-    const auto pos = reader->get_position();
-    if (!list(reader, s)) {
-        return false;
+numbers::integer_value token::integer() const {
+    if (id != token_id::integer) {
+        return {};
     }
-    // map
-    t.id = token_id::none;
-    if (auto iter = table.find(s.c_str()); iter != table.end()) {
-        t.id = iter->second;
+    if (wide) {
+        return numbers::decode_integer(text);
     }
-    if (t.id == token_id::none) {
-        std::cerr << "faield to convert token id:" << s << std::endl;
-        return false;
-    }
-    t.text = s;
-    t.pos = pos;
-    return true;
+    return numbers::integer_value{.magnitude = bits, .negative = negative, .overflow = false};
 }
 
-const token_table operations(operations_table);
-const token_table types(types_table);
-
-bool tokener::operator()(reader_ptr &reader, token &t) const {
-    const position pos = reader->get_position();
-    std::string text;
-
-    if (!parser(reader, text)) {
-        return false;
+numbers::real_value token::real() const {
+    if (id != token_id::real) {
+        return {};
     }
-
-    // update
-    t.id = id;
-    t.pos = pos;
-    t.text = text;
-
-    return true;
+    return numbers::real_value{.value = std::bit_cast<double>(bits), .overflow = overflow};
 }
 
-bool tokenize(reader_ptr &reader, token &t) {
-    using namespace parsers;
-    std::string s;
-
-    static const auto gap = many0(spaces + comment);
-    gap(reader, s);
-
-    static const sigma<token> parsers{attempt(types),
-                                      attempt(operations),
-                                      attempt(tokener(token_id::real, real)),
-                                      attempt(tokener(token_id::integer, integer)),
-                                      attempt(tokener(token_id::boolean, boolean)),
-                                      attempt(tokener(token_id::text, text)),
-                                      attempt(tokener(token_id::character, character)),
-                                      tokener(token_id::variable, variable)};
-
-    return parsers(reader, t);
+token make_token(token_id id, const position &pos, std::string &&text) {
+    token t;
+    t.id = id, t.pos = pos, t.text = std::move(text);
+    t.decode();
+    return t;
 }
 
-bool tokenize_all(reader_ptr &reader, std::vector<token> &ts) {
-    do {
-        token t;
-        if (!tokenize(reader, t)) {
-            break;
-        }
-        ts.emplace_back(std::move(t));
-    } while (1);
-    return true;
-}
+std::ostream &operator<<(std::ostream &os, const token &t) { return os << t.id << ":" << t.text; }
 
 std::ostream &operator<<(std::ostream &os, const std::vector<token> &ts) {
     auto iter = ts.begin();
     if (iter == ts.end()) {
         return os;
     }
-    std::cout << *iter++;
+    os << *iter++;
     for (; iter != ts.end(); iter++) {
-        std::cout << std::endl << *iter;
+        os << '\n' << *iter;
     }
     return os;
 }
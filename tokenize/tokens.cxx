@@ -0,0 +1,128 @@
+#pragma once
+namespace tokenize::tokens {
+
+// 読んだ範囲をtに書き込む
+template <reader_handle Reader>
+static inline void assign(Reader &reader, size_t offset, token &t, token_id id, std::string &&text) {
+    t.id = id;
+    t.pos = reader->locate(offset); // 成功したときだけ行・桁を求める
+    t.text = std::move(text);
+    t.decode();
+}
+
+template <reader_handle Reader>
+static inline void assign(Reader &, size_t offset, lexeme &l, token_id id, parsers::span &&text) {
+    l.id = id;
+    l.offset = offset, l.length = text.length;
+}
+
+// tokenの文字列はstd::stringに、lexemeは範囲だけを書き出す
+template <class T> using text_of = std::conditional_t<std::is_same_v<T, token>, std::string, parsers::span>;
+
+template <reader_handle Reader, token_like T> bool token_table::operator()(Reader &reader, T &t) const {
+    const readers::checkpoint start(reader); // 行・桁を求めるまで先頭を保持する
+    text_of<T> text;
+    // 最終状態からtoken_idが決まる
+    const int index = list.match(reader, text);
+    if (index < 0) {
+        return false;
+    }
+    assign(reader, start.get_offset(), t, ids[index], std::move(text));
+    return true;
+}
+
+template <class P>
+template <reader_handle Reader, token_like T>
+bool tokener<P>::operator()(Reader &reader, T &t) const {
+    const readers::checkpoint start(reader); // 行・桁を求めるまで先頭を保持する
+    text_of<T> text;
+
+    if (!parser(reader, text)) {
+        return false;
+    }
+
+    // update
+    assign(reader, start.get_offset(), t, id, std::move(text));
+    return true;
+}
+
+template <reader_handle Reader, token_like T> bool tokenize(Reader &reader, T &t) {
+    parsers::span s; // 空白とコメントは読み飛ばすだけ
+    gap_grammar()(reader, s);
+    // 文法全体を一つの型として持つのでReaderごとにインライン化される
+    return token_grammar()(reader, t);
+}
+
+template <reader_handle Reader, token_like T> bool tokenize(Reader &reader, T &t, boundary &b) {
+    b.start = reader->get_offset();
+    if constexpr (readers::reach_tracking<Reader>) {
+        reader->clear_reach();
+        const bool result = tokenize(reader, t);
+        b.reach = reader->get_reach();
+        return result;
+    } else {
+        b.reach = SIZE_MAX;
+        return tokenize(reader, t);
+    }
+}
+
+template <reader_handle Reader, token_like T> bool tokenize_all(Reader &reader, std::vector<T> &ts) {
+    do {
+        T t;
+        if (!tokenize(reader, t)) {
+            break;
+        }
+        ts.emplace_back(std::move(t));
+    } while (1);
+    return true;
+}
+
+template <reader_handle Reader, token_like T> bool tokenize_recovering(Reader &reader, T &t) {
+    // 失敗した選択肢がどこまで読み進めたかを記録しながら読む
+    readers::furthest_reader gap_reader(reader);
+    readers::furthest_reader<Reader> *gap_handle = &gap_reader;
+    parsers::span s;
+    recovery_gap_grammar()(gap_handle, s);
+    const size_t gap_furthest = gap_reader.get_furthest();
+
+    const readers::checkpoint start(reader); // 読めなければ読み直す
+    readers::furthest_reader token_reader(reader);
+    readers::furthest_reader<Reader> *token_handle = &token_reader;
+    const bool result = token_grammar()(token_handle, t);
+    // 閉じていないコメントは空白として読めずに巻き戻され、'/'などのトークンとして読めてしまう
+    if (result && gap_furthest <= reader->get_offset()) {
+        return true;
+    }
+    const size_t stop = std::max({gap_furthest, token_reader.get_furthest(), start.get_offset() + 1});
+    start.restore();
+    if (!reader->peek()) {
+        return false; // 終端
+    }
+
+    const parsers::match_t &sync = sync_set();
+    text_of<T> text;
+    // 読み進めた所までと、その後の同期できない文字をまとめる
+    for (auto c = reader->peek(); c; c = reader->peek()) {
+        if (reader->get_offset() >= stop && sync.test((unsigned char)*c)) {
+            break;
+        }
+        reader->next(), text.push_back(*c);
+    }
+    assign(reader, start.get_offset(), t, token_id::error, std::move(text));
+    return true;
+}
+
+template <reader_handle Reader, token_like T> bool tokenize_all_recovering(Reader &reader, std::vector<T> &ts) {
+    bool clean = true;
+    do {
+        T t;
+        if (!tokenize_recovering(reader, t)) {
+            break;
+        }
+        clean &= t.id != token_id::error;
+        ts.emplace_back(std::move(t));
+    } while (1);
+    return clean;
+}
+
+} // namespace tokenize::tokens
@@ -1,17 +1,22 @@
 #pragma once
 
+#include "numbers.hpp"
 #include "parsers.hpp"
 #include "readers.hpp"
+#include <algorithm>
+#include <array>
 #include <iostream>
+#include <span>
+#include <stdexcept>
 #include <string>
-#include <unordered_map>
 namespace tokenize::tokens {
 using parsers::parser_t;
-using readers::reader_ptr, readers::position;
+using readers::reader_ptr, readers::reader_handle, readers::position;
 
 // tokens
 enum class token_id {
     none = 0,
+    error, // 回復モードで読めなかった範囲
     // literal
     boolean = 0x10,
     integer,
@@ -88,40 +93,227 @@ enum class token_id {
     type_str,
     type_func,
 };
+// token_idで引く密な表の大きさ
+inline constexpr size_t token_id_count = size_t(token_id::type_func) + 1;
 
+// 名前("variable", "op[=]", "type[int]"など、知らない番号なら"unknown")
+// 最初に使うときに密な表を作り、以後は添字で引く
+std::string_view name_of(token_id);
 std::ostream &operator<<(std::ostream &, token_id);
 struct token {
     token_id id = token_id::none;
+    // integer, realのときだけtextから求めた値を、idの後ろの隙間とbitsに詰めて持つ
+    bool negative = false; // integer: 負
+    bool overflow = false; // integer: 絶対値が128bitに収まらない, real: 無限大になった
+    bool wide = false;     // integer: 絶対値が64bitに収まらない(integer()はtextから求め直す)
     position pos;
     std::string text;
+    uint64_t bits = 0; // integer: 絶対値, real: doubleのビット列
+
+    // idとtextから値を求め直す
+    void decode();
+    // integer, realでなければ0
+    numbers::integer_value integer() const;
+    numbers::real_value real() const;
 };
 
+// 値を求めたトークンを作る
+token make_token(token_id id, const position &pos, std::string &&text);
+
 std::ostream &operator<<(std::ostream &, const token &);
 
+// 文字列を持たず、入力上の範囲だけを持つトークン(確保しない)
+// 文字列や行・桁、数値は必要になったときに入力から求める(numbers::decode_integer(l.text(src))など)
+struct lexeme {
+    token_id id = token_id::none;
+    size_t offset = 0, length = 0;
+
+    std::string_view text(std::string_view source) const { return source.substr(offset, length); }
+    token to_token(const readers::view_reader &source) const {
+        return make_token(id, source.locate(offset), std::string(text(source.view())));
+    }
+};
+
+// tokenizeの出力になれる型
+template <class T>
+concept token_like = std::same_as<T, token> || std::same_as<T, lexeme>;
+
+// キーワードからtoken_idを引く表(定数式で作る)
 class token_table {
-    std::unordered_map<std::string, token_id> table;
+public:
+    struct entry {
+        std::string_view keyword;
+        token_id id;
+    };
+
+private:
+    std::array<token_id, parsers::multi_list::max_keywords> ids{}; // キーワードの番号 -> token_id
     parsers::multi_list list;
 
+    static constexpr auto keywords_of(std::initializer_list<entry> entries) {
+        if (entries.size() > parsers::multi_list::max_keywords) {
+            throw std::length_error("token_table: too many keywords");
+        }
+        std::array<std::string_view, parsers::multi_list::max_keywords> keywords{};
+        std::transform(entries.begin(), entries.end(), keywords.begin(), [](const entry &e) { return e.keyword; });
+        return keywords;
+    }
+
 public:
-    token_table(const std::unordered_map<std::string, token_id> &_table);
-    bool operator()(reader_ptr &, token &) const;
+    constexpr token_table(std::initializer_list<entry> entries)
+        : list(std::span<const std::string_view>(keywords_of(entries).data(), entries.size())) {
+        std::transform(entries.begin(), entries.end(), ids.begin(), [](const entry &e) { return e.id; });
+    }
+    constexpr const parsers::multi_list &get_list() const { return list; }
+    constexpr std::span<const token_id> get_ids() const { return {ids.data(), list.get_keywords().size()}; }
+    template <reader_handle Reader, token_like T> bool operator()(Reader &, T &) const;
 };
+constexpr parsers::first_t first_of(const token_table &t) { return parsers::first_of(t.get_list()); }
 
-extern const token_table operations;
-extern const token_table types;
+inline constexpr token_table operations = [] {
+    using enum token_id;
+    return token_table{
+        // assign
+        {"=", op_assign},
+        {":=", op_assign_bind},
+        // arith
+        {"+", op_add},
+        {"-", op_sub},
+        {"*", op_mul},
+        {"/", op_div},
+        {"%", op_mod},
+        {"+=", op_assign_add},
+        {"-=", op_assign_sub},
+        {"*=", op_assign_mul},
+        {"/=", op_assign_div},
+        {"%=", op_assign_mod},
+        // compare
+        {"==", op_eq},
+        {"=!", op_ne},
+        {">", op_gt},
+        {">=", op_ge},
+        {"<", op_lt},
+        {"<=", op_le},
+        // bit logic
+        {"~", op_bitnot},
+        {"&", op_bitand},
+        {"|", op_bitor},
+        {"^", op_bitxor},
+        {">>", op_rshfit},
+        {"<<", op_lshfit},
+        {"&=", op_assign_bitand},
+        {"|=", op_assign_bitor},
+        {"^=", op_assign_bitxor},
+        {">>=", op_assign_rshfit},
+        {"<<=", op_assign_lshfit},
+        // logic
+        {"!", op_not},
+        {"&&", op_and},
+        {"||", op_or},
+        {"^^", op_xor},
+        {"&&=", op_assign_and},
+        {"||=", op_assign_or},
+        {"^^=", op_assign_xor},
+        // member
+        {".", op_member},
+        {"->", op_arrow},
+        {"@", op_at},
+        // type
+        {"?", op_option},
+        // bracket
+        {"(", op_bracket_begin},
+        {")", op_bracket_end},
+        {"()", op_bracket_empty},
+        {"{", op_block_begin},
+        {"}", op_block_end},
+        {"[", op_index_begin},
+        {"]", op_index_end},
+        {";", op_line},
+        {",", op_comma},
+        {":", op_colon},
+    };
+}();
 
-class tokener {
+inline constexpr token_table types = [] {
+    using enum token_id;
+    return token_table{
+        {"bool", type_bool}, {"int", type_int}, {"uint", type_uint},
+        {"char", type_char}, {"str", type_str}, {"func", type_func},
+    };
+}();
+
+// 既定では実行時に組み立てた文法のためにparser_tで型消去する
+// 静的な文法ではPを推論させればインライン化される
+template <class P = parser_t<std::string>> class tokener {
     const token_id id;
-    const parser_t<std::string> parser;
+    const P parser;
+    const parsers::first_t first; // 型消去する前に求めておく
 
 public:
-    tokener(const token_id _id, parser_t<std::string> _parser) : id(_id), parser(_parser) {}
-    bool operator()(reader_ptr &, token &) const;
+    template <class Q>
+    constexpr tokener(const token_id _id, const Q &_parser)
+        : id(_id), parser(_parser), first(parsers::first_of(_parser)) {}
+    constexpr token_id get_id() const { return id; }
+    constexpr const P &get_parser() const { return parser; }
+    constexpr const parsers::first_t &get_first() const { return first; }
+    template <reader_handle Reader, token_like T> bool operator()(Reader &, T &) const;
+};
+template <class P> tokener(token_id, const P &) -> tokener<P>;
+template <class P> constexpr parsers::first_t first_of(const tokener<P> &t) { return t.get_first(); }
+
+// 字句解析の文法(tokenizeとautomataで共有する)
+// 定数式で作るので動的な初期化はない
+// トークンの前の空白とコメント
+inline const auto &gap_grammar() {
+    using namespace parsers;
+    static constexpr auto gap = many0(spaces + comment);
+    return gap;
+}
+// トークン(先に書いた選択肢が優先される)
+inline const auto &token_grammar() {
+    using namespace parsers;
+    static constexpr static_sigma grammar{attempt(named<"types">(types)),
+                                      attempt(named<"operations">(operations)),
+                                      attempt(tokener(token_id::real, real)),
+                                      attempt(tokener(token_id::integer, integer)),
+                                      attempt(tokener(token_id::boolean, boolean)),
+                                      attempt(tokener(token_id::text, text)),
+                                      attempt(tokener(token_id::character, character)),
+                                      tokener(token_id::variable, variable)};
+    return grammar;
+}
+
+template <reader_handle Reader, token_like T> bool tokenize(Reader &, T &);
+
+// 一歩(空白・コメントと1トークン)の境界での字句解析の状態
+// 空白とコメントは一歩の中で読み切るので、境界でコメントの途中にいることはない
+// 一歩の結果は開始位置と、そこから調べた範囲の内容だけで決まる
+struct boundary {
+    size_t start = 0;        // 読み始めた位置(直前のトークンの終端)
+    size_t reach = SIZE_MAX; // 先読みを含めて調べた範囲の終端(readerが記録しなければSIZE_MAX)
 };
+template <reader_handle Reader, token_like T> bool tokenize(Reader &, T &, boundary &);
+template <reader_handle Reader, token_like T> bool tokenize_all(Reader &, std::vector<T> &);
 
-bool tokenize(reader_ptr &, token &);
-bool tokenize_all(reader_ptr &, std::vector<token> &);
+// 回復モード
+// どの選択肢にも一致しなければ、読めなかった範囲をtoken_id::errorのトークンにして続ける
+// 読めなかった範囲は、失敗した選択肢が巻き戻す前に読み進めた一番遠い所(少なくとも1文字)までと、
+// その後のトークンか空白・コメントを始められない文字
+// (閉じていない文字列やコメントは終端までの一つのerrorになる)
+// 空白とコメントはattemptで囲んで読むので、コメントになれない'/'は読み飛ばさず演算子として読む
+inline const auto &recovery_gap_grammar() {
+    using namespace parsers;
+    static constexpr auto gap = many0(attempt(spaces + comment));
+    return gap;
+}
+// 読み直しを始められる文字(トークンか空白・コメントの先頭になりうる文字)
+const parsers::match_t &sync_set();
+template <reader_handle Reader, token_like T> bool tokenize_recovering(Reader &, T &);
+// 入力の終端まで読む(errorのトークンがなければtrue)
+template <reader_handle Reader, token_like T> bool tokenize_all_recovering(Reader &, std::vector<T> &);
 
 std::ostream &operator<<(std::ostream &, const std::vector<token> &);
 
-} // namespace tokenize::tokens
\ No newline at end of file
+} // namespace tokenize::tokens
+
+#include "tokens.cxx"
\ No newline at end of file
@@ -0,0 +1,188 @@
+#include "acutest.h"
+#include "tokenize.hpp"
+#include "tokens_testing.hpp"
+#include <sstream>
+
+using namespace tokenize;
+using tokenize::readers::view_reader, tokenize::readers::stream_reader;
+
+// tokenize
+void tokenize_all_test() {
+    const auto ts = lex("func main(){\n  int x=10+0x1f;\n}");
+    const token_id ids[] = {token_id::type_func,      token_id::variable,    token_id::op_bracket_empty,
+                            token_id::op_block_begin, token_id::type_int,    token_id::variable,
+                            token_id::op_assign,      token_id::integer,     token_id::op_add,
+                            token_id::integer,        token_id::op_line,     token_id::op_block_end};
+    TEST_ASSERT(ts.size() == std::size(ids));
+    for (size_t i = 0; i < ts.size() && i < std::size(ids); i++) {
+        TEST_CHECK(ts[i].id == ids[i]);
+    }
+    TEST_ASSERT(ts[4].text == "int" && ts[4].pos == position(15, 1, 2));
+}
+
+void tokenize_concrete_reader_test() {
+    const std::string src = "x := \"a\\\"b\" // c\n/* d */ 1.5e3 'q' true";
+    view_reader source(src);
+    view_reader *reader = &source;
+    std::vector<token> ts;
+    TEST_ASSERT(tokenize_all(reader, ts));
+    TEST_ASSERT(same(ts, lex(src)));
+    TEST_ASSERT(ts.size() == 6 && ts[2].id == token_id::text && ts[3].id == token_id::real);
+}
+
+void tokenize_stream_reader_test() {
+    // tokens cross chunk boundaries
+    const std::string src = "abcdefghijklmnop = 0x1234_5678; /* comment */ \"text text\" 1.25";
+    std::istringstream source(src);
+    stream_reader r(source, 2);
+    stream_reader *reader = &r;
+    std::vector<token> ts;
+    TEST_ASSERT(tokenize_all(reader, ts));
+    TEST_ASSERT(same(ts, lex(src)));
+    TEST_ASSERT(r.buffered() <= 8);
+}
+
+void tokenize_memo_test() {
+    // packrat mode gives the same tokens
+    const std::string src = "x = [1, -2.5, 0x1F_FF, 0b10.01e-3, 0q12, 0o7., 3_4_5e+6, 1.e, 0d99.9];\n"
+                            "y = 1.5e; z = 0x.; 1..2 -0 +0.0";
+    view_reader source(src);
+    view_reader *reader = &source;
+    readers::memo_table table;
+    source.set_memo(&table);
+    std::vector<token> ts;
+    TEST_ASSERT(tokenize_all(reader, ts));
+    TEST_ASSERT(same(ts, lex(src)));
+    TEST_CHECK(table.size() > 0);
+}
+
+static std::vector<token> recover(std::string_view src, bool clean) {
+    auto reader = make_string_reader(src);
+    std::vector<token> ts;
+    TEST_CHECK(tokenize_all_recovering(reader, ts) == clean);
+    return ts;
+}
+
+void tokenize_recovering_test() {
+    // unknown characters become one error token and lexing resumes
+    auto ts = recover("x = 1 $$ y", false);
+    TEST_ASSERT(ts.size() == 5);
+    TEST_CHECK(ts[2].id == token_id::integer && ts[2].integer().magnitude == 1);
+    TEST_CHECK(ts[3].id == token_id::error && ts[3].text == "$$" && ts[3].pos == position(6, 0, 6));
+    TEST_CHECK(ts[4].id == token_id::variable && ts[4].text == "y");
+
+    // an unterminated string or comment is one error up to the end
+    ts = recover("a \"bc d", false);
+    TEST_ASSERT(ts.size() == 2);
+    TEST_CHECK(ts[1].id == token_id::error && ts[1].text == "\"bc d" && ts[1].pos == position(2, 0, 2));
+    ts = recover("\"abc", false);
+    TEST_ASSERT(ts.size() == 1);
+    TEST_CHECK(ts[0].id == token_id::error && ts[0].text == "\"abc");
+    ts = recover("x /* ok */ y /* open", false);
+    TEST_ASSERT(ts.size() == 3);
+    TEST_CHECK(ts[1].id == token_id::variable && ts[1].text == "y");
+    TEST_CHECK(ts[2].id == token_id::error && ts[2].text == "/* open" && ts[2].pos == position(13, 0, 13));
+
+    // a multi-byte character is one token
+    ts = recover("\xc3\xa9 b", false);
+    TEST_ASSERT(ts.size() == 2);
+    TEST_CHECK(ts[0].id == token_id::error && ts[0].text == "\xc3\xa9");
+
+    // a lone slash is an operator, not a broken comment
+    ts = recover("a / b /", true);
+    TEST_ASSERT(ts.size() == 4);
+    TEST_CHECK(ts[1].id == token_id::op_div && ts[3].id == token_id::op_div);
+
+    // valid input gives the same tokens as tokenize_all
+    const std::string src = "func main(){\n  int x=10+0x1f; // c\n  y = \"s\" /* d */ 1.5e3;\n}";
+    TEST_CHECK(same(recover(src, true), lex(src)));
+
+    // chunk boundaries do not change the result
+    const std::string broken = "abc @@@ def ## \"ghi";
+    std::istringstream source(broken);
+    stream_reader r(source, 2);
+    stream_reader *reader = &r;
+    std::vector<token> chunked;
+    TEST_CHECK(!tokenize_all_recovering(reader, chunked));
+    TEST_CHECK(same(chunked, recover(broken, false)));
+}
+
+// lexeme
+void lexeme_test() {
+    const std::string src = "func f() { x += 0b1_0; } // done\n\"s\" 'c' 1.0";
+    view_reader source(src);
+    view_reader *reader = &source;
+    std::vector<lexeme> ls;
+    TEST_ASSERT(tokenize_all(reader, ls));
+
+    const auto ts = lex(src);
+    TEST_ASSERT(ls.size() == ts.size());
+    for (size_t i = 0; i < ls.size() && i < ts.size(); i++) {
+        const token t = ls[i].to_token(source);
+        TEST_CHECK(t.id == ts[i].id && t.pos == ts[i].pos && t.text == ts[i].text);
+        TEST_CHECK(ls[i].text(src) == ts[i].text);
+    }
+}
+
+// 値はidの後ろの隙間と64bitに詰める
+static_assert(sizeof(token) <= 8 + sizeof(position) + sizeof(std::string) + 8);
+
+// integer, realは字句解析と同時に値を求める
+void token_value_test() {
+    const auto ts = lex("x = 0x1_0 + 1.5e2 + 0b1.1e3");
+    TEST_ASSERT(ts.size() == 7);
+    int64_t i;
+    TEST_CHECK(ts[2].id == token_id::integer && ts[2].integer().to_int64(i) && i == 16);
+    TEST_CHECK(ts[4].id == token_id::real && ts[4].real().value == 150);
+    TEST_CHECK(ts[6].id == token_id::real && ts[6].real().value == 12);
+    TEST_CHECK(ts[0].integer().magnitude == 0 && ts[0].real().value == 0);
+
+    // 64bitを超える絶対値はtextから求め直す
+    const auto wide = lex("0x1_0000_0000_0000_0000 1.0e400");
+    TEST_ASSERT(wide.size() == 2);
+    TEST_CHECK(wide[0].wide && wide[0].integer().magnitude == (unsigned __int128)1 << 64);
+    TEST_CHECK(wide[1].real().overflow && !wide[1].wide);
+
+    // lexemeから作っても同じ値になる
+    view_reader source("1_024");
+    view_reader *reader = &source;
+    std::vector<lexeme> ls;
+    TEST_ASSERT(tokenize_all(reader, ls) && ls.size() == 1);
+    TEST_CHECK(ls[0].to_token(source).integer().magnitude == 1024);
+    TEST_CHECK(numbers::decode_integer(ls[0].text(source.view())).magnitude == 1024);
+}
+
+// runtime tokener
+void tokener_runtime_test() {
+    const tokens::tokener<> t(token_id::variable, parsers::parser_t<std::string>(parsers::variable));
+    auto reader = make_string_reader("abc");
+    token out;
+    TEST_ASSERT(t(reader, out) && out.id == token_id::variable && out.text == "abc");
+}
+
+// キーワードの表は定数式で作られる
+void token_table_test() {
+    static_assert(tokens::types.get_list().get_keywords().size() == tokens::types.get_ids().size());
+    static_assert(tokens::first_of(tokens::operations).match.test('='));
+    auto reader = make_string_reader("<<=uint");
+    token out;
+    TEST_ASSERT(tokens::operations(reader, out) && out.id == token_id::op_assign_lshfit && out.text == "<<=");
+    TEST_ASSERT(tokens::types(reader, out) && out.id == token_id::type_uint && out.text == "uint");
+}
+
+TEST_LIST = {
+    // tokenize
+    {"tokenize_all_test", tokenize_all_test},
+    {"tokenize_concrete_reader_test", tokenize_concrete_reader_test},
+    {"tokenize_stream_reader_test", tokenize_stream_reader_test},
+    {"tokenize_memo_test", tokenize_memo_test},
+    {"tokenize_recovering_test", tokenize_recovering_test},
+    // lexeme
+    {"lexeme_test", lexeme_test},
+    {"token_value_test", token_value_test},
+    // tokener
+    {"tokener_runtime_test", tokener_runtime_test},
+    // token_table
+    {"token_table_test", token_table_test},
+    // end
+    {nullptr, nullptr}};
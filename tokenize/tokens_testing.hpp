@@ -0,0 +1,27 @@
+#pragma once
+// テストで共有する補助関数(acutest.hの後に読み込む)
+#include "tokens.hpp"
+#include <string_view>
+#include <vector>
+
+// srcをtokenize_allで読んだトークン列
+static inline std::vector<tokenize::tokens::token> lex(std::string_view src) {
+    tokenize::readers::view_reader source(src);
+    tokenize::readers::view_reader *reader = &source;
+    std::vector<tokenize::tokens::token> ts;
+    TEST_ASSERT(tokenize::tokens::tokenize_all(reader, ts));
+    return ts;
+}
+
+// 種類と位置と文字列が同じ(値はそれらから決まる)
+static inline bool same(const std::vector<tokenize::tokens::token> &x, const std::vector<tokenize::tokens::token> &y) {
+    if (x.size() != y.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < x.size(); i++) {
+        if (x[i].id != y[i].id || x[i].pos != y[i].pos || x[i].text != y[i].text) {
+            return false;
+        }
+    }
+    return true;
+}
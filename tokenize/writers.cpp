@@ -0,0 +1,235 @@
+#include "writers.hpp"
+#include <algorithm>
+#include <assert.h>
+#include <charconv>
+namespace tokenize::writers {
+using tokens::token_id;
+
+////////////////////////////////////////////////////////////////////////////////
+//// writer ////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+writer::writer(std::ostream &_os, size_t capacity) : os(_os), buffer(std::max<size_t>(capacity, 32)) {}
+
+writer::~writer() { flush(); }
+
+void writer::drain() {
+    os.write(buffer.data(), used);
+    used = 0;
+}
+
+void writer::write(std::string_view s) {
+    if (s.size() > buffer.size() - used) {
+        drain();
+        if (s.size() > buffer.size()) {
+            os.write(s.data(), s.size()); // バッファより大きければ直接書く
+            return;
+        }
+    }
+    std::copy(s.begin(), s.end(), buffer.data() + used);
+    used += s.size();
+}
+
+void writer::write_decimal(uint64_t n) {
+    char digits[20];
+    const auto result = std::to_chars(std::begin(digits), std::end(digits), n);
+    write(std::string_view(digits, result.ptr - digits));
+}
+
+void writer::write_hex(uint64_t n) {
+    char digits[16];
+    const auto result = std::to_chars(std::begin(digits), std::end(digits), n, 16);
+    write(std::string_view(digits, result.ptr - digits));
+}
+
+void writer::write_le(uint64_t n, size_t bytes) {
+    assert(bytes <= 8);
+    for (size_t i = 0; i < bytes; i++) {
+        put(char(n >> (8 * i)));
+    }
+}
+
+void writer::flush() {
+    drain();
+    os.flush();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//// format ////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+std::optional<format_t> parse_format(std::string_view name) {
+    if (name == "text") {
+        return format_t::text;
+    }
+    if (name == "jsonl") {
+        return format_t::jsonl;
+    }
+    if (name == "binary") {
+        return format_t::binary;
+    }
+    return std::nullopt;
+}
+
+namespace {
+
+// sの先頭にあるUTF-8の1文字の長さ(正しくなければ0)
+size_t utf8_length(std::string_view s) {
+    const unsigned char c = s[0];
+    size_t n;
+    unsigned char low = 0x80, high = 0xbf; // 2バイト目の範囲(冗長な表現とサロゲートを除く)
+    if (c < 0x80) {
+        return 1;
+    } else if (0xc2 <= c && c <= 0xdf) {
+        n = 2;
+    } else if (0xe0 <= c && c <= 0xef) {
+        n = 3, low = c == 0xe0 ? 0xa0 : 0x80, high = c == 0xed ? 0x9f : 0xbf;
+    } else if (0xf0 <= c && c <= 0xf4) {
+        n = 4, low = c == 0xf0 ? 0x90 : 0x80, high = c == 0xf4 ? 0x8f : 0xbf;
+    } else {
+        return 0;
+    }
+    if (s.size() < n || (unsigned char)s[1] < low || (unsigned char)s[1] > high) {
+        return 0;
+    }
+    for (size_t i = 2; i < n; i++) {
+        if ((unsigned char)s[i] < 0x80 || (unsigned char)s[i] > 0xbf) {
+            return 0;
+        }
+    }
+    return n;
+}
+
+// JSONの文字列として書く
+// 制御文字と'"', '\\'は書き換え、UTF-8として正しくないバイトは1バイトずつU+FFFDに置き換える
+void write_json_string(writer &out, std::string_view s) {
+    out.put('"');
+    size_t begin = 0;
+    for (size_t i = 0; i < s.size();) {
+        const unsigned char c = s[i];
+        if (c >= 0x80) {
+            if (const size_t n = utf8_length(s.substr(i)); n > 0) {
+                i += n;
+                continue;
+            }
+        } else if (c >= 0x20 && c != '"' && c != '\\') {
+            i++;
+            continue;
+        }
+        out.write(s.substr(begin, i - begin));
+        begin = ++i;
+        switch (c) {
+        case '"':
+            out.write("\\\"");
+            break;
+        case '\\':
+            out.write("\\\\");
+            break;
+        case '\n':
+            out.write("\\n");
+            break;
+        case '\r':
+            out.write("\\r");
+            break;
+        case '\t':
+            out.write("\\t");
+            break;
+        default:
+            if (c >= 0x80) {
+                out.write("\\ufffd");
+                break;
+            }
+            out.write("\\u00");
+            out.put("0123456789abcdef"[c >> 4]);
+            out.put("0123456789abcdef"[c & 0xf]);
+            break;
+        }
+    }
+    out.write(s.substr(begin));
+    out.put('"');
+}
+
+void write_text(writer &out, const token &t) {
+    out.write(tokens::name_of(t.id));
+    out.put('(');
+    out.write_hex(uint64_t(t.id));
+    out.write("):");
+    out.write(t.text);
+}
+
+void write_json(writer &out, const token &t, size_t line, size_t offset) {
+    out.write("{\"line\":");
+    out.write_decimal(line + t.pos.line);
+    out.write(",\"column\":");
+    out.write_decimal(t.pos.number);
+    out.write(",\"offset\":");
+    out.write_decimal(offset + t.pos.offset);
+    out.write(",\"id\":");
+    out.write_decimal(uint64_t(t.id));
+    out.write(",\"name\":");
+    write_json_string(out, tokens::name_of(t.id));
+    out.write(",\"text\":");
+    write_json_string(out, t.text);
+    out.write("}\n");
+}
+
+// 32bitに収まらない項目があれば何も書かずにfalseを返す
+bool write_binary(writer &out, token_id id, size_t line, size_t column, size_t offset, std::string_view text) {
+    if (line > UINT32_MAX || column > UINT32_MAX || offset > UINT32_MAX || text.size() > UINT32_MAX) {
+        return false;
+    }
+    out.write_le(uint16_t(id), 2);
+    out.write_le(line, 4);
+    out.write_le(column, 4);
+    out.write_le(offset, 4);
+    out.write_le(text.size(), 4);
+    out.write(text);
+    return true;
+}
+
+} // namespace
+
+bool token_writer::write(const std::vector<token> &ts, size_t line, size_t offset) {
+    switch (format) {
+    case format_t::text:
+        for (size_t i = 0; i < ts.size(); i++) {
+            if (i > 0) {
+                out.put('\n');
+            }
+            write_text(out, ts[i]);
+        }
+        out.put('\n');
+        break;
+    case format_t::jsonl:
+        for (const token &t : ts) {
+            write_json(out, t, line, offset);
+        }
+        break;
+    case format_t::binary:
+        for (const token &t : ts) {
+            if (!write_binary(out, t.id, line + t.pos.line, t.pos.number, offset + t.pos.offset, t.text)) {
+                return false;
+            }
+        }
+        break;
+    }
+    return true;
+}
+
+bool token_writer::write_failed(size_t line) {
+    switch (format) {
+    case format_t::text:
+        out.write("failed\n");
+        break;
+    case format_t::jsonl:
+        out.write("{\"line\":");
+        out.write_decimal(line);
+        out.write(",\"failed\":true}\n");
+        break;
+    case format_t::binary:
+        return write_binary(out, token_id::none, line, 0, 0, {});
+    }
+    return true;
+}
+
+} // namespace tokenize::writers
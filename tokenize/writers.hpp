@@ -0,0 +1,74 @@
+#pragma once
+#include "tokens.hpp"
+#include <optional>
+#include <ostream>
+#include <stddef.h>
+#include <stdint.h>
+#include <string_view>
+#include <vector>
+namespace tokenize::writers {
+using tokens::token;
+
+// 大きなバッファに貯めて、いっぱいになったときとflushのときだけ書き出す
+// トークンごとにstd::endlで書き出すと、そのたびにflushが走る
+class writer {
+    std::ostream &os;
+    std::vector<char> buffer;
+    size_t used = 0;
+
+    void drain();
+
+public:
+    static constexpr size_t default_capacity = size_t(1) << 20;
+
+    writer(std::ostream &_os, size_t capacity = default_capacity);
+    writer(const writer &) = delete;
+    ~writer();
+
+    void put(char c) {
+        if (used == buffer.size()) {
+            drain();
+        }
+        buffer[used++] = c;
+    }
+    void write(std::string_view s);
+    void write_decimal(uint64_t n);
+    void write_hex(uint64_t n);
+    // 下位バイトから書く
+    void write_le(uint64_t n, size_t bytes);
+    // 貯めた分を書き出してosもflushする
+    void flush();
+
+    size_t buffered() const { return used; }
+};
+
+// silang --formatの出力形式
+// text: これまでと同じ"名前(16進の番号):文字列"を1行に1トークン(トークンのない入力の行は空行)
+// jsonl: 1行に1トークンのJSON {"line":行,"column":桁,"offset":入力の先頭からのバイト数,"id":番号,"name":名前,"text":文字列}
+//        (textのUTF-8として正しくないバイトはU+FFFDに置き換える)
+// binary: 1トークンごとに、リトルエンディアンのu16 id, u32 line, u32 column, u32 offset, u32 lengthと文字列
+//         (32bitに収まらない項目のあるトークンは書けない)
+enum class format_t { text, jsonl, binary };
+
+// "text", "jsonl", "binary"
+std::optional<format_t> parse_format(std::string_view);
+
+// トークン列をformatで書き出す
+// 入力を1行ずつ字句解析するので、行番号と位置はその行の分(0から)を足して書く
+class token_writer {
+    writer out;
+    format_t format;
+
+public:
+    token_writer(std::ostream &os, format_t _format, size_t capacity = writer::default_capacity)
+        : out(os, capacity), format(_format) {}
+
+    // 入力のoffsetバイト目から始まるline行目から読んだトークン列
+    // 形式で表せないトークンがあれば、その手前まで書いてfalseを返す
+    bool write(const std::vector<token> &ts, size_t line = 0, size_t offset = 0);
+    // line行目を読めなかった(text: "failed", jsonl: {"line":行,"failed":true}, binary: idがnoneで長さ0)
+    bool write_failed(size_t line = 0);
+    void flush() { out.flush(); }
+};
+
+} // namespace tokenize::writers
@@ -0,0 +1,134 @@
+#include "acutest.h"
+#include "tokenize.hpp"
+#include "tokens_testing.hpp"
+#include <sstream>
+
+using namespace tokenize;
+
+static std::string render(format_t format, const std::vector<token> &ts, size_t line, size_t capacity) {
+    std::ostringstream os;
+    {
+        token_writer out(os, format, capacity);
+        out.write(ts, line);
+    }
+    return os.str();
+}
+
+// names
+void name_of_test() {
+    TEST_CHECK(tokens::name_of(token_id::variable) == "variable");
+    TEST_CHECK(tokens::name_of(token_id::error) == "error");
+    TEST_CHECK(tokens::name_of(token_id::op_assign_bind) == "op[:=]");
+    TEST_CHECK(tokens::name_of(token_id::type_int) == "type[int]");
+    TEST_CHECK(tokens::name_of(token_id(0x0f)) == "unknown");
+    TEST_CHECK(tokens::name_of(token_id(0x1000)) == "unknown");
+
+    std::ostringstream os;
+    os << token_id::op_block_end << ' ' << token_id(0x1000);
+    TEST_CHECK(os.str() == "op[}](a4) unknown(1000)");
+}
+
+// writer
+void writer_test() {
+    std::ostringstream os;
+    {
+        writer out(os, 32);
+        out.write("0x");
+        out.write_hex(0xbeef);
+        out.put(' ');
+        out.write_decimal(18446744073709551615ull);
+        out.write_le(0x0102, 2);
+        TEST_CHECK(os.str().empty()); // not written until full or flushed
+        out.write(std::string(40, 'z'));
+        TEST_CHECK(out.buffered() == 0);
+    }
+    TEST_CHECK(os.str() == "0xbeef 18446744073709551615\x02\x01" + std::string(40, 'z'));
+}
+
+// formats
+void text_format_test() {
+    const auto ts = lex("int x := y + 0x1f; // c");
+    std::ostringstream expect;
+    expect << ts << '\n';
+    TEST_CHECK(render(format_t::text, ts, 0, writer::default_capacity) == expect.str());
+    TEST_CHECK(render(format_t::text, ts, 0, 8) == expect.str());
+    TEST_CHECK(render(format_t::text, {}, 0, 8) == "\n");
+}
+
+void jsonl_format_test() {
+    const auto ts = lex("x = \"a\\\"b\\\\\" '\t'");
+    const std::string out = render(format_t::jsonl, ts, 3, 16);
+    TEST_CHECK(out == "{\"line\":3,\"column\":0,\"offset\":0,\"id\":21,\"name\":\"variable\",\"text\":\"x\"}\n"
+                      "{\"line\":3,\"column\":2,\"offset\":2,\"id\":32,\"name\":\"op[=]\",\"text\":\"=\"}\n"
+                      "{\"line\":3,\"column\":4,\"offset\":4,\"id\":19,\"name\":\"text\","
+                      "\"text\":\"\\\"a\\\\\\\"b\\\\\\\\\\\"\"}\n"
+                      "{\"line\":3,\"column\":13,\"offset\":13,\"id\":20,\"name\":\"character\",\"text\":\"'\\t'\"}\n");
+
+    std::ostringstream os;
+    {
+        token_writer w(os, format_t::jsonl);
+        w.write_failed(7);
+        // offsets count from the start of the whole input
+        w.write(lex("ef"), 8, 6);
+    }
+    TEST_CHECK(os.str() == "{\"line\":7,\"failed\":true}\n"
+                           "{\"line\":8,\"column\":0,\"offset\":6,\"id\":21,\"name\":\"variable\",\"text\":\"ef\"}\n");
+}
+
+void jsonl_utf8_test() {
+    // valid UTF-8 is kept, anything else becomes U+FFFD byte by byte
+    token t;
+    t.id = token_id::error;
+    t.text = "\xc3\xa9\xe3\x81\x82\xf0\x9f\x98\x80|\xff|\xc3|\xe3\x81|\xc0\xaf|\xed\xa0\x80|\x80";
+    const std::string out = render(format_t::jsonl, {t}, 0, 16);
+    const std::string text = out.substr(out.find("\"text\":") + 7);
+    TEST_CHECK(text == "\"\xc3\xa9\xe3\x81\x82\xf0\x9f\x98\x80|\\ufffd|\\ufffd|\\ufffd\\ufffd|\\ufffd\\ufffd|"
+                       "\\ufffd\\ufffd\\ufffd|\\ufffd\"}\n");
+    TEST_MSG("%s", text.c_str());
+}
+
+void binary_format_test() {
+    const auto ts = lex("ab\n  cd");
+    const std::string out = render(format_t::binary, ts, 2, 8);
+    const auto u = [&out](size_t at, size_t bytes) {
+        uint64_t n = 0;
+        for (size_t i = bytes; i-- > 0;) {
+            n = n << 8 | (unsigned char)out[at + i];
+        }
+        return n;
+    };
+    TEST_ASSERT(out.size() == 2 * 18 + 4);
+    TEST_CHECK(u(0, 2) == uint16_t(token_id::variable) && u(2, 4) == 2 && u(6, 4) == 0 && u(10, 4) == 0);
+    TEST_CHECK(u(14, 4) == 2 && out.substr(18, 2) == "ab");
+    TEST_CHECK(u(20, 2) == uint16_t(token_id::variable) && u(22, 4) == 3 && u(26, 4) == 2 && u(30, 4) == 5);
+    TEST_CHECK(u(34, 4) == 2 && out.substr(38, 2) == "cd");
+}
+
+void binary_limit_test() {
+    // fields beyond 32 bits fail the write instead of being truncated
+    const auto ts = lex("ab cd");
+    std::ostringstream os;
+    {
+        token_writer out(os, format_t::binary);
+        TEST_CHECK(out.write(ts, 0, UINT32_MAX - 3));
+        TEST_CHECK(!out.write(ts, 0, UINT32_MAX - 2)); // cd starts past 32 bits
+        TEST_CHECK(!out.write(ts, size_t(1) << 32));
+        TEST_CHECK(!out.write_failed(size_t(1) << 32));
+        TEST_CHECK(out.write_failed(1));
+    }
+    TEST_CHECK(os.str().size() == 2 * (18 + 2) + (18 + 2) + 18);
+}
+
+TEST_LIST = {
+    // names
+    {"name_of_test", name_of_test},
+    // writer
+    {"writer_test", writer_test},
+    // formats
+    {"text_format_test", text_format_test},
+    {"jsonl_format_test", jsonl_format_test},
+    {"jsonl_utf8_test", jsonl_utf8_test},
+    {"binary_format_test", binary_format_test},
+    {"binary_limit_test", binary_limit_test},
+    // end
+    {nullptr, nullptr}};